@@ -0,0 +1,246 @@
+// internal
+#include "vec3f.hpp"
+#include "camera.hpp"
+#include "scene.hpp"
+#include "scenes.hpp"
+#include "devices.hpp"
+// external
+#include "CL/cl2.hpp"
+// standard
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+
+using namespace std;
+
+/*** benchmark suite ***/
+
+// fixed cases so results stay comparable across releases
+struct BenchmarkCase {
+    const char* scene;
+    unsigned int width, height, spp;
+};
+
+static const BenchmarkCase CASES[] = {
+    { "cornell",        640, 480, 4 },
+    { "dielectric",     640, 480, 4 },
+    { "triangle",       640, 480, 4 },
+    { "terrain",        640, 480, 2 },
+    { "terrain_large",  640, 480, 2 },
+};
+
+struct BenchmarkResult {
+    /* case and backend - "cpu", "megakernel", "wavefront" or "bands" */
+    BenchmarkCase bench;
+    string backend;
+    /* worker threads of cpu backend - zero for opencl */
+    unsigned int threads = 0;
+    /* wall time of prepare_rendering, e.g. kernel creation */
+    double setup = 0;
+    /* first frame builds the bvh and uploads the whole scene */
+    double first_wall = 0;
+    RenderTimings first;
+    /* following frames - mean and minimum wall time and mean phases */
+    unsigned int n_frames = 0;
+    double mean_wall = 0, min_wall = 0;
+    RenderTimings mean;
+};
+
+
+/*** command line ***/
+
+/* largest accepted thread and frame count */
+#define MAX_THREADS 1024
+#define MAX_FRAMES 10000
+
+struct Options {
+    /* json output file */
+    string output = "benchmark.json";
+    /* backends to run - "cpu", "gpu" or "<platform>:<device>" for both opencl pipelines, "none" skips opencl */
+    string device = "gpu";
+    bool cpu = true;
+    /* render bands on all gpus and the cpu at the same time */
+    bool bands = false;
+    /* number of cpu threads (0 uses all cores) and timed frames per case */
+    unsigned int threads = 0, frames = 3;
+    /* run only this scene if not empty */
+    string scene;
+};
+
+void usage(const char* prog) {
+    cout << "Usage: " << prog << " [options]" << endl
+         << "  --output <file.json> results (default benchmark.json)" << endl
+         << "  --device <device>    opencl device: gpu, <platform>:<device> or none (default gpu)" << endl
+         << "  --cpu <0|1>          run cpu backend (default 1)" << endl
+         << "  --bands <0|1>        run all gpus plus cpu on bands of each frame (default 0)" << endl
+         << "  --threads <n>        cpu worker threads, 0 for all cores (default 0)" << endl
+         << "  --frames <n>         timed frames per case after the first (default 3)" << endl
+         << "  --scene <name>       run only the cases of this scene" << endl;
+}
+
+bool parse_uint(const char* value, unsigned int max, unsigned int* result) {
+    // digits only - strtoul would accept a sign and wrap negative values around
+    if (!isdigit((unsigned char)value[0])) return false;
+    char* end = nullptr;
+    errno = 0;
+    unsigned long v = strtoul(value, &end, 10);
+    if ((*end != '\0') || (errno == ERANGE) || (v > max)) return false;
+    *result = v;
+    return true;
+}
+
+bool parse_args(int argc, char** argv, Options* opts) {
+    for (int i = 1; i < argc; i++) {
+        string key = argv[i];
+        // every option takes exactly one value
+        if (i + 1 >= argc) { cout << "Missing value for " << key << endl; return false; }
+        const char* value = argv[++i];
+        bool valid = true; unsigned int flag = 0;
+        if (key == "--output") opts->output = value;
+        else if (key == "--device") opts->device = value;
+        else if (key == "--cpu") { valid = parse_uint(value, 1, &flag); opts->cpu = (flag != 0); }
+        else if (key == "--bands") { valid = parse_uint(value, 1, &flag); opts->bands = (flag != 0); }
+        else if (key == "--threads") valid = parse_uint(value, MAX_THREADS, &opts->threads);
+        else if (key == "--frames") valid = parse_uint(value, MAX_FRAMES, &opts->frames);
+        else if (key == "--scene") opts->scene = value;
+        else { cout << "Unknown option " << key << endl; return false; }
+        if (!valid) { cout << "Invalid value " << value << " for " << key << endl; return false; }
+    }
+    // at least one timed frame
+    if (opts->frames == 0) { cout << "Frames must be positive" << endl; return false; }
+    return true;
+}
+
+
+/*** run ***/
+
+static double seconds_since(chrono::steady_clock::time_point start) {
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static void add_timings(RenderTimings* sum, const RenderTimings& t, double scale) {
+    sum->update += t.update * scale; sum->upload += t.upload * scale;
+    sum->trace += t.trace * scale; sum->readback += t.readback * scale;
+}
+
+BenchmarkResult run_case(const BenchmarkCase& bench, const string& backend, const cl::Device* device, const vector<cl::Device>& gpus, const Options& opts) {
+    BenchmarkResult result;
+    result.bench = bench; result.backend = backend;
+    // create scene
+    Scene* scene = new Scene();
+    load_scene(bench.scene, scene);
+    Camera* cam = scene->get_active_camera();
+    cam->antialiasing(bench.spp);
+    if (device != nullptr) { cam->assign(*device); cam->wavefront(backend == "wavefront"); }
+    else if (backend == "bands") cam->assign(gpus, true);
+    else {
+        if (opts.threads > 0) cam->threads(opts.threads);
+        result.threads = cam->threads();
+    }
+    // prepare rendering
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    cam->prepare_rendering(bench.width, bench.height);
+    result.setup = seconds_since(start);
+    // first frame
+    vector<char> pixels(4 * bench.width * bench.height);
+    start = chrono::steady_clock::now();
+    cam->render(pixels.data(), bench.width, bench.height);
+    result.first_wall = seconds_since(start);
+    result.first = cam->timings();
+    // timed frames
+    result.n_frames = opts.frames;
+    for (unsigned int f = 0; f < opts.frames; f++) {
+        start = chrono::steady_clock::now();
+        cam->render(pixels.data(), bench.width, bench.height);
+        double wall = seconds_since(start);
+        result.mean_wall += wall / opts.frames;
+        result.min_wall = (f == 0)? wall : min(result.min_wall, wall);
+        add_timings(&result.mean, cam->timings(), 1.0 / opts.frames);
+    }
+    // clean up
+    cam->clear_rendering();
+    delete scene;
+    return result;
+}
+
+
+/*** json ***/
+
+static void write_timings(ostream& out, const RenderTimings& t) {
+    out << "{ \"update\": " << t.update << ", \"upload\": " << t.upload
+        << ", \"trace\": " << t.trace << ", \"readback\": " << t.readback << " }";
+}
+
+void write_json(ostream& out, const vector<BenchmarkResult>& results, const string& device_name) {
+    out << "{" << endl;
+    out << "  \"opencl_device\": \"" << device_name << "\"," << endl;
+    out << "  \"results\": [" << endl;
+    for (unsigned int i = 0; i < results.size(); i++) {
+        const BenchmarkResult& r = results[i];
+        // rays per second only count camera rays so cpu and opencl are measured alike
+        double primary_rays = (double)r.bench.width * r.bench.height * r.bench.spp;
+        out << "    {" << endl
+            << "      \"scene\": \"" << r.bench.scene << "\", \"backend\": \"" << r.backend << "\", \"threads\": " << r.threads << "," << endl
+            << "      \"width\": " << r.bench.width << ", \"height\": " << r.bench.height << ", \"spp\": " << r.bench.spp << "," << endl
+            << "      \"setup_s\": " << r.setup << "," << endl
+            << "      \"first_frame\": { \"wall_s\": " << r.first_wall << ", \"phases_s\": "; write_timings(out, r.first); out << " }," << endl;
+        out << "      \"frames\": " << r.n_frames << "," << endl
+            << "      \"wall_s\": " << r.mean_wall << ", \"min_wall_s\": " << r.min_wall << "," << endl
+            << "      \"primary_rays_per_s\": " << primary_rays / r.mean_wall << "," << endl
+            << "      \"phases_s\": "; write_timings(out, r.mean); out << endl;
+        out << "    }" << ((i + 1 < results.size())? "," : "") << endl;
+    }
+    out << "  ]" << endl << "}" << endl;
+}
+
+
+/*** main ***/
+
+int main(int argc, char** argv) {
+
+    // read options
+    Options opts;
+    if ((argc == 2) && ((strcmp(argv[1], "--help") == 0) || (strcmp(argv[1], "-h") == 0))) { usage(argv[0]); return 0; }
+    if (!parse_args(argc, argv, &opts)) { usage(argv[0]); return 1; }
+
+    // opencl backends are skipped without a device
+    cl::Device device;
+    bool use_device = (opts.device != "none") && select_device(opts.device, &device);
+    string device_name = use_device? device.getInfo<CL_DEVICE_NAME>() : "";
+    device_name.erase(remove(device_name.begin(), device_name.end(), '\0'), device_name.end());
+    if (!use_device && (opts.device != "none")) cout << "Skipping OpenCL backends" << endl;
+    vector<cl::Device> gpus;
+    if (opts.bands) gpu_devices(&gpus);
+
+    // run all cases on all backends
+    vector<BenchmarkResult> results;
+    for (const BenchmarkCase& bench : CASES) {
+        if (!opts.scene.empty() && (opts.scene != bench.scene)) continue;
+        if (opts.cpu) results.push_back(run_case(bench, "cpu", nullptr, gpus, opts));
+        if (use_device) {
+            results.push_back(run_case(bench, "megakernel", &device, gpus, opts));
+            results.push_back(run_case(bench, "wavefront", &device, gpus, opts));
+        }
+        if (opts.bands) results.push_back(run_case(bench, "bands", nullptr, gpus, opts));
+    }
+    if (results.empty()) { cout << "Nothing to run" << endl; return 1; }
+
+    // summary
+    for (const BenchmarkResult& r : results)
+        cout << r.bench.scene << " / " << r.backend << ": " << r.mean_wall << "s per frame" << endl;
+
+    // write results
+    ofstream out(opts.output);
+    if (!out) { cout << "Could not write " << opts.output << endl; return 2; }
+    write_json(out, results, device_name);
+    cout << "Saved results: " << opts.output << endl;
+
+    return 0;
+}
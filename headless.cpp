@@ -0,0 +1,129 @@
+// internal
+#include "vec3f.hpp"
+#include "camera.hpp"
+#include "scene.hpp"
+#include "scenes.hpp"
+#include "devices.hpp"
+// external
+#include "CL/cl2.hpp"
+// standard
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <cctype>
+#include <cerrno>
+
+using namespace std;
+
+/*** command line ***/
+
+/* largest accepted image edge, sample count and thread count */
+#define MAX_IMAGE_SIZE 16384
+#define MAX_SAMPLES 65536
+#define MAX_THREADS 1024
+
+struct Options {
+    /* scene and output file */
+    string scene = "cornell";
+    string output = "img/render.bmp";
+    /* resolution, samples per pixel and lights sampled per hit (0 checks all lights) */
+    unsigned int width = 800, height = 600, spp = 4, light_samples = 0;
+    /* "cpu", "gpu", "all" or "<platform>:<device>" and number of cpu threads (0 uses all cores) */
+    string device = "cpu";
+    unsigned int threads = 0;
+    /* opencl pipeline - "megakernel" or "wavefront" */
+    string pipeline = "megakernel";
+};
+
+void usage(const char* prog) {
+    cout << "Usage: " << prog << " [options]" << endl
+         << "  --scene <name>       dielectric, cornell, triangle, terrain or terrain_large (default cornell)" << endl
+         << "  --width <pixels>     image width (default 800)" << endl
+         << "  --height <pixels>    image height (default 600)" << endl
+         << "  --spp <n>            samples per pixel (default 4)" << endl
+         << "  --light-samples <n>  lights picked by power per hit, 0 for all lights (default 0)" << endl
+         << "  --device <device>    cpu, gpu, all (gpus and cpu together) or <platform>:<device> (default cpu)" << endl
+         << "  --threads <n>        cpu worker threads, 0 for all cores (default 0)" << endl
+         << "  --pipeline <name>    opencl pipeline: megakernel or wavefront (default megakernel)" << endl
+         << "  --output <file.bmp>  output image (default img/render.bmp)" << endl;
+}
+
+bool parse_uint(const char* value, unsigned int max, unsigned int* result) {
+    // digits only - strtoul would accept a sign and wrap negative values around
+    if (!isdigit((unsigned char)value[0])) return false;
+    char* end = nullptr;
+    errno = 0;
+    unsigned long v = strtoul(value, &end, 10);
+    if ((*end != '\0') || (errno == ERANGE) || (v > max)) return false;
+    *result = v;
+    return true;
+}
+
+bool parse_args(int argc, char** argv, Options* opts) {
+    for (int i = 1; i < argc; i++) {
+        string key = argv[i];
+        // every option takes exactly one value
+        if (i + 1 >= argc) { cout << "Missing value for " << key << endl; return false; }
+        const char* value = argv[++i];
+        bool valid = true;
+        if (key == "--scene") opts->scene = value;
+        else if (key == "--output") opts->output = value;
+        else if (key == "--width") valid = parse_uint(value, MAX_IMAGE_SIZE, &opts->width);
+        else if (key == "--height") valid = parse_uint(value, MAX_IMAGE_SIZE, &opts->height);
+        else if (key == "--spp") valid = parse_uint(value, MAX_SAMPLES, &opts->spp);
+        else if (key == "--light-samples") valid = parse_uint(value, MAX_SAMPLES, &opts->light_samples);
+        else if (key == "--device") opts->device = value;
+        else if (key == "--threads") valid = parse_uint(value, MAX_THREADS, &opts->threads);
+        else if (key == "--pipeline") opts->pipeline = value;
+        else { cout << "Unknown option " << key << endl; return false; }
+        if (!valid) { cout << "Invalid value " << value << " for " << key << endl; return false; }
+    }
+    // reject empty images and zero samples
+    if ((opts->width == 0) || (opts->height == 0) || (opts->spp == 0)) { cout << "Width, height and spp must be positive" << endl; return false; }
+    if ((opts->pipeline != "megakernel") && (opts->pipeline != "wavefront")) { cout << "Unknown pipeline " << opts->pipeline << endl; return false; }
+    return true;
+}
+
+
+/*** main ***/
+
+int main(int argc, char** argv) {
+
+    // read options
+    Options opts;
+    if ((argc == 2) && ((strcmp(argv[1], "--help") == 0) || (strcmp(argv[1], "-h") == 0))) { usage(argv[0]); return 0; }
+    if (!parse_args(argc, argv, &opts)) { usage(argv[0]); return 1; }
+
+    // create scene
+    Scene *scene = new Scene();
+    if (!load_scene(opts.scene.c_str(), scene)) {
+        cout << "Unknown scene " << opts.scene << endl;
+        delete scene;
+        return 1;
+    }
+    Camera* cam = scene->get_active_camera();
+    cam->antialiasing(opts.spp);
+    cam->light_samples(opts.light_samples);
+
+    // render on opencl device, on bands of all gpus and the cpu or on all cpu cores
+    cl::Device device;
+    if (opts.device == "all") {
+        vector<cl::Device> devices; gpu_devices(&devices);
+        cam->assign(devices, true);
+        if (opts.threads > 0) cam->threads(opts.threads);
+    } else if (opts.device != "cpu") {
+        if (!select_device(opts.device, &device)) { delete scene; return 1; }
+        cam->assign(device);
+        cam->wavefront(opts.pipeline == "wavefront");
+    } else if (opts.threads > 0) cam->threads(opts.threads);
+
+    // render straight to file
+    bool saved = cam->render_to_file(opts.output.c_str(), opts.width, opts.height, 1);
+
+    // destroy
+    delete scene;
+
+    return saved? 0 : 2;
+}
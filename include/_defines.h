@@ -3,7 +3,9 @@
 /*** Basics ***/
 
 #define EPS 1e-5f   // make sure this is of float type
-#define MAX_RECURSION_DEPTH 4
+#ifndef MAX_RECURSION_DEPTH
+#define MAX_RECURSION_DEPTH 4   // kernels may be built with a different depth
+#endif
 
 /*** Geometries ***/
 
@@ -16,6 +18,11 @@
 /* Triangle */
 #define GEOMETRY_TRIANGLE_TYPE_ID 2
 #define GEOMETRY_TRIANGLE_TYPE_SIZE 1 + 9   // first value defines applied material id
+/* Triangle Mesh */
+#define GEOMETRY_TRIANGLEMESH_TYPE_ID 3
+#define GEOMETRY_TRIANGLEMESH_TYPE_SIZE 1 + 2   // material id, first triangle and number of triangles in mesh buffer
+/* number of geometry types */
+#define GEOMETRY_N_TYPES 4
 
 
 /*** Materials ***/
@@ -29,6 +36,8 @@
 /* Dielectric Material */
 #define MATERIAL_DIELECTRIC_TYPE_ID 2
 #define MATERIAL_DIELECTRIC_TYPE_SIZE 4
+/* number of material types */
+#define MATERIAL_N_TYPES 3
 
 
 /*** Lights ***/
@@ -36,3 +45,21 @@
 /* Point Light */
 #define LIGHT_POINTLIGHT_TYPE_ID 0
 #define LIGHT_POINTLIGHT_TYPE_SIZE 6
+/* number of light types */
+#define LIGHT_N_TYPES 1
+
+
+/*** Kernel Features ***/
+
+/* kernels built with -D SCENE_FEATURES only compile the types enabled by further flags */
+/* e.g. -D GEOMETRY_SPHERE_ENABLED - without feature flags every type is compiled in */
+#ifndef SCENE_FEATURES
+#define GEOMETRY_SPHERE_ENABLED
+#define GEOMETRY_PLANE_ENABLED
+#define GEOMETRY_TRIANGLE_ENABLED
+#define GEOMETRY_TRIANGLEMESH_ENABLED
+#define MATERIAL_DIFFUSE_ENABLED
+#define MATERIAL_METAL_ENABLED
+#define MATERIAL_DIELECTRIC_ENABLED
+#define LIGHT_POINTLIGHT_ENABLED
+#endif
@@ -0,0 +1,85 @@
+#pragma once
+#include <vector>
+#include "vec3f.hpp"
+#include "vec3f8.hpp"
+#include "memCompressor.hpp"
+#include "sphereStore.hpp"
+
+// forward declarations
+class Geometry;
+
+/* build parameters */
+#define BVH_MAX_LEAF_SIZE 8      // fills one register of the sphere store
+#define BVH_SAH_BINS 16
+#define BVH_MAX_SAH_DEPTH 64     // fall back to median splits below this depth to bound the recursion
+#define BVH_TOP_LEVELS 6         // stored breadth-first before all other nodes so devices can keep them in local memory
+
+/* flattened nodes and primitives - keep in sync with src/kernels/structs.cl */
+
+struct BVHNode {
+    /* bounding box and index of node to continue with once the subtree is missed or done */
+    float bmin[3]; unsigned int skip;
+    float bmax[3]; unsigned int child;  // inner: index of first child - leaf: index of first primitive
+    /* number of primitives in leaf - zero for inner nodes */
+    unsigned int count;
+};
+
+struct BVHPrimitive {
+    /* offset of geometry data in compressor, its type and id */
+    unsigned int offset, type_id, id;
+    /* index of primitive within geometry (e.g. triangle of mesh) */
+    unsigned int index;
+};
+
+// Bounding Volume Hierarchy over the geometries of a memory compressor
+
+class BVH {
+
+    private:
+    /* geometries */
+    const MemCompressor* geometries;
+    /* flattened hierarchy - unbounded geometries are stored before all leaf primitives */
+    std::vector<BVHNode>* nodes_;
+    std::vector<BVHPrimitive>* prims_;
+    unsigned int n_unbounded_;
+    /* spheres of all primitives in structure-of-arrays layout */
+    SphereStore* spheres_;
+    /* state of compressor the hierarchy was built for */
+    unsigned int n_built, version_built;
+    /* increased whenever nodes or primitives change */
+    unsigned int version_;
+
+    /* build helpers */
+    struct BuildPrimitive { Vec3f min, max, centroid; BVHPrimitive prim; };
+    unsigned int build_node(std::vector<BuildPrimitive>& items, unsigned int begin, unsigned int end, unsigned int depth);
+    void link(unsigned int node_id, unsigned int skip);
+    void store_top_levels(void);
+    /* test ray against single primitive and update closest hit */
+    void cast_primitive(const BVHPrimitive& prim, const Vec3f origin, const Vec3f dir, Geometry** geometry, unsigned int* index, float* t, bool* hit) const;
+    bool primitive_blocks(const BVHPrimitive& prim, const Vec3f origin, const Vec3f dir, float t_max) const;
+    void cast_primitive_packet(const BVHPrimitive& prim, const Vec3f8& origin, const Vec3f8& dir, Float8 active, Geometry** geometry, unsigned int* index, Float8* t, Float8* hit) const;
+
+    public:
+    /* constructor and destructor */
+    BVH(const MemCompressor* geometries);
+    ~BVH(void);
+    /* full SAH build */
+    void build(void);
+    /* recompute bounding boxes bottom-up keeping the topology */
+    void refit(void);
+    /* rebuild on added geometries and refit on changed geometries */
+    void update(void);
+    /* cast ray to geometries - returns closest geometry and index of hit primitive within it */
+    bool cast(const Vec3f origin, const Vec3f dir, Geometry** geometry, unsigned int* index, float* t) const;
+    /* cast packet of coherent rays - returns mask of hit lanes, geometry and index arrays hold one entry per lane */
+    /* inactive lanes never hit */
+    Float8 cast_packet(const Vec3f8& origin, const Vec3f8& dir, Float8 active, Geometry** geometry, unsigned int* index, Float8* t) const;
+    /* any geometry hit at a distance up to t_max - stops at the first hit found, e.g. for shadow rays */
+    bool occluded(const Vec3f origin, const Vec3f dir, float t_max) const;
+    /* getters */
+    const std::vector<BVHNode>* nodes(void) const { return this->nodes_; }
+    const std::vector<BVHPrimitive>* prims(void) const { return this->prims_; }
+    unsigned int n_unbounded(void) const { return this->n_unbounded_; }
+    const SphereStore* spheres(void) const { return this->spheres_; }
+    unsigned int version(void) const { return this->version_; }
+};
@@ -1,8 +1,16 @@
-#include "Vec3f.hpp"
+#include "vec3f.hpp"
+#include <string>
+#include <vector>
+#include <map>
 
 // forward declarations
 class Scene;
 class Geometry;
+class TileScheduler;
+class CompressorBuffer;
+class VectorBuffer;
+struct Wavefront;
+struct FramePipeline;
 namespace cl {
     class Device;
     class Context;
@@ -12,6 +20,30 @@ namespace cl {
     class Buffer;
 };
 
+/* most frames an opencl camera renders ahead of the presented one */
+#define MAX_FRAMES_IN_FLIGHT 3
+/* local memory kept free for placeholder arguments and alignment when staging scene data */
+#define LOCAL_MEM_RESERVE 256
+
+/* wall time of the phases of the last rendered frame in seconds */
+/* with frames in flight trace only covers enqueueing and readback the wait for the presented frame */
+struct RenderTimings {
+    /* bvh rebuild or refit, upload of scene changes, tracing and copying pixels back to the host */
+    double update = 0, upload = 0, trace = 0, readback = 0;
+};
+
+/* state of a path traced on the cpu - plain data on the stack like the private memory of a work-item */
+struct PathState {
+    /* current ray and product of the colors along the path */
+    Vec3f origin, direction, color;
+};
+
+/* sample statistics of a pixel over the accumulated frames - keep in sync with src/kernels/structs.cl */
+struct PixelStats {
+    /* samples taken and sum of their squared luminances */
+    unsigned int spp; float sum_sq;
+};
+
 class Camera {
     private:
     /* reference to scene */
@@ -24,32 +56,121 @@ class Camera {
     float FOV_ = 60.0*3.14159265/180;
     /* anti-aliasing */
     unsigned int n_samples = 1;
+    /* lights picked by power at each hit - zero checks all lights */
+    unsigned int light_samples_ = 0;
+    /* adaptive sampling - pixels stop taking samples once the standard error of their mean after gamma correction */
+    /* falls below the threshold or they reached the maximum number of samples (zero for no maximum) */
+    /* the minimum keeps rare bright paths from passing as converged after the first few samples */
+    float adaptive_threshold_ = 0;
+    unsigned int adaptive_min_samples_ = 16;
+    unsigned int adaptive_max_samples_ = 0;
+    /* cpu rendering - worker threads are only started by the first cpu frame */
+    unsigned int n_threads_;
+    TileScheduler* scheduler = nullptr;
+    /* seed of random numbers - cpu and opencl renders draw the same streams */
+    unsigned int seed_ = 0;
+    /* progressive rendering - sum of frame colors accumulated since the last change */
+    float* accum = nullptr;
+    /* sample statistics of each pixel */
+    PixelStats* stats = nullptr;
+    unsigned int accum_size = 0;
+    unsigned int n_accumulated = 0;
+    unsigned int accum_version = 0;
+    /* phases of last frame */
+    RenderTimings timings_;
 
     /* OpenCL set up */
     bool openCL_assigned = false;
     const cl::Device* device;
     cl::Context* context;
     cl::CommandQueue* queue;
-    cl::Program* program;
+    /* kernel source and one program per set of build options - the current one fits the scene features */
+    std::string* source;
+    std::map<std::string, cl::Program*>* programs;
+    cl::Program* program = nullptr;
+    std::string program_options;
+    /* local memory of device - scene data that does not fit is read from global memory */
+    unsigned long local_mem_size = 0;
+    /* geometries, materials and lights staged in local memory by the current program and number of top bvh nodes */
+    bool local_staged[3] = { true, true, true };
+    unsigned int n_local_nodes = 0;
+    /* work-group shape of the megakernel of the current program - zero until tuned */
+    unsigned int group_rows = 0, group_cols = 0;
     /* OpenCL helpers */
     cl::Kernel* kern = nullptr;
     cl::Buffer* pixel_buf = nullptr;
     cl::Buffer* globals_buf = nullptr;
+    cl::Buffer* accum_buf = nullptr;
+    cl::Buffer* stats_buf = nullptr;
+    /* persistent device copies of the scene */
+    CompressorBuffer* geometry_buf = nullptr;
+    CompressorBuffer* material_buf = nullptr;
+    CompressorBuffer* light_buf = nullptr;
+    VectorBuffer* bvh_nodes_buf = nullptr;
+    VectorBuffer* bvh_prims_buf = nullptr;
+    VectorBuffer* bvh_spheres_buf = nullptr;
+    VectorBuffer* mesh_vertices_buf = nullptr;
+    VectorBuffer* mesh_indices_buf = nullptr;
+    VectorBuffer* light_alias_buf = nullptr;
+    /* render with wavefront kernels instead of the megakernel */
+    bool wavefront_ = false;
+    Wavefront* wf = nullptr;
+    /* frames in flight - more than one reads pixels back without blocking and presents an older frame */
+    unsigned int frames_in_flight_ = 1;
+    FramePipeline* pipeline = nullptr;
+    /* zero-copy presentation - pixel buffer lives in host memory and is mapped instead of read */
+    /* requested and active - only a pixel buffer allocated by prepare_rendering with the request can be mapped */
+    bool zero_copy_ = false, zero_copy_active = false;
+    void* mapped_pixels = nullptr;
+    /* multi-device rendering - one camera per band of rows, each on its own device or the cpu */
+    std::vector<Camera*>* bands = nullptr;
+    /* first row of each band followed by the image height and measured rows per second of each band */
+    std::vector<unsigned int>* band_rows = nullptr;
+    std::vector<double>* band_speed = nullptr;
 
     /* private methods */
-    Vec3f get_color(pair<Vec3f, Vec3f>* ray, unsigned int r_depth = 0) const;
-    Vec3f get_pixel_color(unsigned int i, unsigned int j, unsigned int w, unsigned int h) const;
+    /* trace path whose first hit is already known - same loop as camera_get_ray_color of the kernel */
+    Vec3f trace(PathState* path, bool hit, Geometry* geo, unsigned int index, float dist) const;
+    /* shade hit or miss of current ray and continue with scattered ray - returns whether the path goes on */
+    bool bounce(PathState* path, bool hit, Geometry* geo, unsigned int index, float dist) const;
+    /* colors and summed squared luminances of n <= PACKET_SIZE neighbouring pixels of a row */
+    /* primary rays of the lanes set in the mask are traced as one packet */
+    void get_packet_color(unsigned int i, unsigned int j, unsigned int n, unsigned int w, unsigned int h, int lanes, Vec3f* colors, float* sum_sq) const;
+    /* adaptive sampling is done with pixel given its accumulated colors */
+    bool pixel_converged(const float* sum, const PixelStats& stats) const;
     std::pair<Vec3f,Vec3f> ray(float i, float j, unsigned int w, unsigned int h) const;
-    /* private render methods */
-    void render_cpu(void* pixels, unsigned int w, unsigned int h) const;
-    void render_gpu(void* pixels, unsigned int w, unsigned int h) const;
+    /* private render methods - render rows [y0, y1) of the image */
+    void render_rows(void* pixels, unsigned int w, unsigned int h, unsigned int y0, unsigned int y1);
+    void render_cpu(void* pixels, unsigned int w, unsigned int h, unsigned int y0, unsigned int y1);
+    void render_gpu(void* pixels, unsigned int w, unsigned int h, unsigned int y0, unsigned int y1);
+    /* multi-device helpers */
+    void render_bands(void* pixels, unsigned int w, unsigned int h);
+    void split_bands(unsigned int w, unsigned int h);
+    void read_accum(float* dst, size_t first, size_t count);
+    void write_accum(const float* src, size_t first, size_t count);
+    void read_stats(PixelStats* dst, size_t first, size_t count);
+    void write_stats(const PixelStats* src, size_t first, size_t count);
+    /* private opencl helpers */
+    void plan_local_memory(bool* staged, unsigned int* n_nodes) const;
+    std::string build_options(void) const;
+    cl::Program* get_program(const std::string& options);
+    void select_program(void);
+    bool sync_scene(void);
+    void set_scene_args(cl::Kernel& kernel, unsigned int first_arg, unsigned int first_accel_arg) const;
+    void select_work_group(unsigned int w, unsigned int y0, unsigned int y1);
+    void render_megakernel(unsigned int w, unsigned int h, unsigned int y0, unsigned int y1);
+    void render_wavefront(unsigned int w, unsigned int h);
+    void read_pipelined(void* pixels, unsigned int w, unsigned int h);
 
     public:
     /* constructors and destructor */
-    Camera(Scene* scene, unsigned int id);
+    Camera(const Scene* scene, unsigned int id);
     ~Camera(void);
     /* assign open-cl device to camera */
     void assign(const cl::Device device);
+    /* render bands of every frame on all devices and optionally the cpu at the same time */
+    /* band heights follow the measured speed of each device - only the megakernel renders bands */
+    void assign(const std::vector<cl::Device>& devices, bool cpu);
     /* transform */
     void transform(Vec3f pos, Vec3f dir, Vec3f up);
     /* setters */
@@ -58,15 +179,44 @@ class Camera {
     void up(Vec3f up);
     void FOV(float FOV);
     void antialiasing(unsigned int n_samples);
+    void light_samples(unsigned int n_samples);
+    /* stop sampling pixels that converged - every frame still takes antialiasing samples in the others */
+    /* a threshold of zero disables it, the wavefront pipeline is replaced by the megakernel while enabled */
+    void adaptive(float threshold, unsigned int min_samples, unsigned int max_samples);
+    void threads(unsigned int n_threads);
+    void seed(unsigned int seed);
+    void wavefront(bool enabled);
+    void frames_in_flight(unsigned int n_frames);
+    void zero_copy(bool enabled);
+    /* restart progressive accumulation */
+    void reset_accumulation(void);
     /* getters */
     Vec3f position(void) const { return this->pos_; }
     Vec3f direction(void) const { return this->dir_; }
     Vec3f up(void) const { return this->up_; }
     float FOV(void) const { return this->FOV_; }
     unsigned int antialiasing(void) const { return this->n_samples; }
+    unsigned int light_samples(void) const { return this->light_samples_; }
+    float adaptive_threshold(void) const { return this->adaptive_threshold_; }
+    unsigned int adaptive_min_samples(void) const { return this->adaptive_min_samples_; }
+    unsigned int adaptive_max_samples(void) const { return this->adaptive_max_samples_; }
+    unsigned int threads(void) const;
+    unsigned int seed(void) const { return this->seed_; }
+    bool wavefront(void) const { return this->wavefront_; }
+    unsigned int frames_in_flight(void) const { return this->frames_in_flight_; }
+    bool zero_copy(void) const { return this->zero_copy_active && this->openCL_assigned; }
+    unsigned int accumulated(void) const { return this->n_accumulated; }
+    unsigned int n_bands(void) const { return (this->bands != nullptr)? this->bands->size() : 1; }
+    const RenderTimings& timings(void) const { return this->timings_; }
+    /* samples taken per pixel since accumulation restarted, row by row */
+    void spp_map(std::vector<unsigned int>* counts);
     /* render */
-    void render(void* pixels, unsigned int w, unsigned int h) const;
-    void render_to_file(const char* fname, int width, int height, int dpi);
+    void render(void* pixels, unsigned int w, unsigned int h);
+    /* render with zero copy - returns the mapped pixel buffer which stays valid until unmap_pixels */
+    /* opencl only, takes precedence over frames in flight - renders nothing and returns null unless zero_copy() */
+    const void* render_mapped(unsigned int w, unsigned int h);
+    void unmap_pixels(void);
+    bool render_to_file(const char* fname, int width, int height, int dpi);
     /* prepare and clear rendering */
     void prepare_rendering(unsigned int w, unsigned int h);
     void clear_rendering(void);
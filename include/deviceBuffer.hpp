@@ -0,0 +1,69 @@
+#pragma once
+#include <vector>
+#include "memCompressor.hpp"
+
+// forward declarations
+namespace cl {
+    class Context;
+    class CommandQueue;
+    class Buffer;
+};
+
+// Device copy of a memory compressor - only uploads data changed since the last sync
+
+class CompressorBuffer {
+
+    private:
+    /* opencl context and queue used for uploads */
+    cl::Context* context;
+    cl::CommandQueue* queue;
+    /* compressor to mirror */
+    const MemCompressor* compressor;
+    /* device buffers - the instance table holds the type ids of all instances followed by their data offsets */
+    cl::Buffer* data_;
+    cl::Buffer* table_;
+    unsigned int data_capacity, table_capacity;
+    /* host copy of instance table - kept alive until its upload finished */
+    std::vector<unsigned int>* table;
+    /* state of compressor at last sync */
+    bool synced;
+    unsigned int version_synced, n_synced;
+    /* reused list of changed ranges */
+    std::vector<std::pair<unsigned int, unsigned int>>* ranges;
+
+    public:
+    /* constructor and destructor */
+    CompressorBuffer(cl::Context* context, cl::CommandQueue* queue, const MemCompressor* compressor);
+    ~CompressorBuffer(void);
+    /* upload changes of compressor - returns whether anything was enqueued */
+    bool sync(void);
+    /* getters */
+    const cl::Buffer& data(void) const { return *this->data_; }
+    const cl::Buffer& instance_table(void) const { return *this->table_; }
+};
+
+// Device copy of a host array - uploaded as a whole whenever its version changes
+
+class VectorBuffer {
+
+    private:
+    /* opencl context and queue used for uploads */
+    cl::Context* context;
+    cl::CommandQueue* queue;
+    /* device buffer and its size in bytes */
+    cl::Buffer* buffer_;
+    size_t capacity;
+    /* version at last sync */
+    bool synced;
+    unsigned int version_synced;
+
+    public:
+    /* constructor and destructor */
+    VectorBuffer(cl::Context* context, cl::CommandQueue* queue);
+    ~VectorBuffer(void);
+    /* upload data if version changed - reallocates only if the data outgrows the buffer */
+    /* returns whether anything was enqueued */
+    bool sync(const void* data, size_t bytes, unsigned int version);
+    /* getter */
+    const cl::Buffer& buffer(void) const { return *this->buffer_; }
+};
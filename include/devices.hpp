@@ -0,0 +1,14 @@
+#pragma once
+#include <string>
+#include <vector>
+
+// forward declarations
+namespace cl {
+    class Device;
+};
+
+/* find opencl device by name - "gpu" picks the first gpu of any platform, "<platform>:<device>" picks by index */
+/* logs the reason and returns false if no such device exists */
+bool select_device(const std::string& name, cl::Device* device);
+/* gpus of all platforms */
+void gpu_devices(std::vector<cl::Device>* devices);
@@ -1,6 +1,8 @@
-#include "Vec3f.hpp"
+#include "vec3f.hpp"
+#include "vec3f8.hpp"
 #include "memCompressor.hpp"
 #include "_defines.h"
+#include <vector>
 
 // forward declaration
 class Material;
@@ -17,6 +19,17 @@ class Geometry : public Compressable {
     virtual bool cast(const Vec3f origin, const Vec3f dir, float* t) const = 0;
     /* compute normal at given position */
     virtual Vec3f normal(const Vec3f p) const = 0;
+    /* axis aligned bounding box - returns false for unbounded geometries */
+    virtual bool bounds(Vec3f* min, Vec3f* max) const = 0;
+    /* primitives - geometries made of several primitives (e.g. meshes) override these */
+    virtual unsigned int n_primitives(void) const { return 1; }
+    virtual bool primitive_cast(unsigned int, const Vec3f origin, const Vec3f dir, float* t) const { return this->cast(origin, dir, t); }
+    virtual Vec3f primitive_normal(unsigned int, const Vec3f p) const { return this->normal(p); }
+    virtual bool primitive_bounds(unsigned int, Vec3f* min, Vec3f* max) const { return this->bounds(min, max); }
+    /* cast packet of rays - returns mask of hit lanes, distances are only valid in hit lanes */
+    /* tests each lane on its own unless overridden */
+    virtual Float8 cast_packet(const Vec3f8& origin, const Vec3f8& dir, Float8* t) const;
+    virtual Float8 primitive_cast_packet(unsigned int, const Vec3f8& origin, const Vec3f8& dir, Float8* t) const { return this->cast_packet(origin, dir, t); }
 };
 
 // Sphere
@@ -47,7 +60,9 @@ class Sphere : public Geometry {
     void apply(Config* config);
     /* override geometry method */
     bool cast(const Vec3f origin, const Vec3f dir, float* t) const;
+    Float8 cast_packet(const Vec3f8& origin, const Vec3f8& dir, Float8* t) const;
     Vec3f normal(Vec3f p) const;
+    bool bounds(Vec3f* min, Vec3f* max) const;
 };
 
 // Plane
@@ -78,7 +93,9 @@ class Plane : public Geometry {
     void apply(Config* config);
     /* override geometry method */
     bool cast(const Vec3f origin, const Vec3f dir, float* t) const;
+    Float8 cast_packet(const Vec3f8& origin, const Vec3f8& dir, Float8* t) const;
     Vec3f normal(Vec3f p) const;
+    bool bounds(Vec3f* min, Vec3f* max) const;
 };
 
 
@@ -112,5 +129,91 @@ class Triangle : public Plane {
     void apply(Config* config);
     /* override geometry method */
     bool cast(const Vec3f origin, const Vec3f dir, float* t) const;
+    Float8 cast_packet(const Vec3f8& origin, const Vec3f8& dir, Float8* t) const;
     Vec3f normal(Vec3f p) const;
+    bool bounds(Vec3f* min, Vec3f* max) const;
+};
+
+
+// Triangle Mesh
+
+class FileNotFound : public std::exception {
+    /* error message */
+    virtual const char* what(void) const throw() { return "File not found."; }
+};
+
+class InvalidObjFile : public std::exception {
+    /* error message */
+    virtual const char* what(void) const throw() { return "Invalid face in obj file."; }
+};
+
+class InvalidMeshIndices : public std::exception {
+    /* error message */
+    virtual const char* what(void) const throw() { return "Mesh indices out of range."; }
+};
+
+class MeshBuffer {
+
+    private:
+    /* shared vertices (x, y, z) and three vertex indices per triangle */
+    std::vector<float>* vertices_;
+    std::vector<unsigned int>* indices_;
+    /* increased whenever a mesh is added */
+    unsigned int version_ = 0;
+
+    public:
+    /* constructor and destructor */
+    MeshBuffer(void);
+    ~MeshBuffer(void);
+    /* append mesh and return index of its first triangle - indices must be full triangles of existing vertices */
+    unsigned int add(const std::vector<Vec3f>* vertices, const std::vector<unsigned int>* indices);
+    /* corner of triangle */
+    Vec3f vertex(unsigned int triangle, unsigned int corner) const;
+    /* getters */
+    const std::vector<float>* vertices(void) const { return this->vertices_; }
+    const std::vector<unsigned int>* indices(void) const { return this->indices_; }
+    unsigned int n_triangles(void) const { return this->indices_->size() / 3; }
+    unsigned int version(void) const { return this->version_; }
+};
+
+class TriangleMeshConfig : public Config {
+    public:
+    /* vertices and three vertex indices per triangle */
+    std::vector<Vec3f> vertices;
+    std::vector<unsigned int> indices;
+    /* buffer and first triangle - set when the mesh is added to a scene */
+    MeshBuffer* buffer = nullptr;
+    unsigned int first_triangle = 0;
+    /* constructors */
+    TriangleMeshConfig(std::vector<Vec3f> vertices, std::vector<unsigned int> indices);
+    /* load vertices and faces from wavefront obj file - throws on faces with invalid vertex indices */
+    static TriangleMeshConfig* from_obj(const char* fname);
+};
+
+class TriangleMesh : public Geometry {
+
+    private:
+    /* shared vertex and index buffer */
+    const MeshBuffer* buffer = nullptr;
+    /* getters */
+    unsigned int first_triangle(void) const;
+    /* setters */
+    void set_triangles(unsigned int first, unsigned int n);
+
+    public:
+    /* Geometry Type ID and required size */
+    unsigned int get_type_id(void) const { return GEOMETRY_TRIANGLEMESH_TYPE_ID; }
+    unsigned int get_size(void) const { return GEOMETRY_TRIANGLEMESH_TYPE_SIZE; }
+    /* apply config */
+    void apply(Config* config);
+    /* override geometry method - whole mesh */
+    bool cast(const Vec3f origin, const Vec3f dir, float* t) const;
+    Vec3f normal(Vec3f p) const;
+    bool bounds(Vec3f* min, Vec3f* max) const;
+    /* override geometry method - single triangles */
+    unsigned int n_primitives(void) const;
+    bool primitive_cast(unsigned int prim, const Vec3f origin, const Vec3f dir, float* t) const;
+    Float8 primitive_cast_packet(unsigned int prim, const Vec3f8& origin, const Vec3f8& dir, Float8* t) const;
+    Vec3f primitive_normal(unsigned int prim, const Vec3f p) const;
+    bool primitive_bounds(unsigned int prim, Vec3f* min, Vec3f* max) const;
 };
@@ -1,5 +1,5 @@
 #pragma once
-#include "Vec3f.hpp"
+#include "vec3f.hpp"
 #include "memCompressor.hpp"
 #include "_defines.h"
 
@@ -19,6 +19,8 @@ class Light : public Compressable {
     virtual float light_distance_squarred(Vec3f p) const = 0;
     /* light color at position p */
     virtual Vec3f light_color(Vec3f p) const = 0;
+    /* emitted power used to pick lights when sampling */
+    virtual float power(void) const = 0;
 };
 
 
@@ -50,4 +52,5 @@ class PointLight : public Light {
     Vec3f light_direction(Vec3f p) const;
     float light_distance_squarred(Vec3f p) const;
     Vec3f light_color(Vec3f p) const;
+    float power(void) const;
 };
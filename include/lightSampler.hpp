@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include "memCompressor.hpp"
+
+/* alias table entry of one light - keep in sync with src/kernels/structs.cl */
+
+struct LightAlias {
+    /* probability of keeping this light when its slot is drawn, otherwise alias is taken */
+    float prob; unsigned int alias;
+    /* probability of drawing this light at all */
+    float pdf;
+};
+
+// Alias table over the lights of a memory compressor
+// lights are drawn proportional to their power in constant time:
+//   draw slot k uniformly, keep light k with probability prob[k], otherwise take alias[k]
+// one number u in [0, 1) picks the slot with its integer part and decides with its fraction
+
+class LightSampler {
+
+    private:
+    /* lights */
+    const MemCompressor* lights;
+    /* one entry per light in instance order */
+    std::vector<LightAlias>* entries_;
+    /* state of compressor the table was built for */
+    unsigned int n_built, version_built;
+    /* increased whenever the table changes */
+    unsigned int version_;
+
+    public:
+    /* constructor and destructor */
+    LightSampler(const MemCompressor* lights);
+    ~LightSampler(void);
+    /* build table with vose's method - lights without power are never drawn unless all are */
+    void build(void);
+    /* rebuild on added or changed lights */
+    void update(void);
+    /* index of light picked by u in [0, 1) and probability of picking it */
+    unsigned int sample(float u, float* pdf) const;
+    /* getters */
+    const std::vector<LightAlias>* entries(void) const { return this->entries_; }
+    unsigned int version(void) const { return this->version_; }
+};
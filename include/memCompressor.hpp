@@ -1,29 +1,50 @@
 #pragma once
 #include <vector>
+#include <atomic>
+#include <thread>
 #include <exception>
+#include <new>
+#include <cstddef>
+
+/* floats in the first memory chunk of a compressor - later chunks double the capacity */
+#define MEM_COMPRESSOR_CHUNK_SIZE 1024
+/* bytes in each block of the instance pool */
+#define INSTANCE_POOL_BLOCK_SIZE 16384
 
 class Config {};
+class MemCompressor;
+
+class EditRequiredException : public std::exception {
+    public:
+    virtual const char* what(void) const throw() { return "Instances may only change within an edit of their scene."; }
+};
 
 class Compressable {
     private:
     /* reference to list to store values */
     float *data_;
-    /* id of instance in memory compressor */
-    unsigned int id_;
+    /* id of instance in memory compressor and offset of its data */
+    unsigned int id_, offset_;
+    /* compressor owning the data */
+    MemCompressor* compressor_ = nullptr;
 
     protected:
-    /* read-write data */
+    /* read-write data - renderer reads see the pinned version, writes need an edit of the scene */
     const float read(unsigned int i) const;
     void write(unsigned int i, float v);
 
     public:
-    /* constructors */
+    /* constructors and destructor */
     Compressable(void);
+    virtual ~Compressable(void) {}
     /* getters */
     unsigned int id(void) const { return this->id_; };
+    const float* data(void) const { return this->data_; }
     /* setters */
     void id(unsigned int id);
+    void offset(unsigned int offset);
     void data(float* data);
+    void compressor(MemCompressor* compressor);
     /* get required data size to store instance */
     virtual unsigned int get_size(void) const = 0;
     /* get id of type */
@@ -33,53 +54,162 @@ class Compressable {
 };
 
 
+/* Renderer Reads */
+
+class RendererReads {
+
+    private:
+    /* number of live objects on the calling thread */
+    static thread_local unsigned int depth_;
+
+    public:
+    /* reads of instances on the calling thread see pinned snapshots while an object lives */
+    RendererReads(void) { RendererReads::depth_++; }
+    ~RendererReads(void) { RendererReads::depth_--; }
+    /* whether the calling thread reads for a renderer */
+    static bool active(void) { return RendererReads::depth_ > 0; }
+};
+
+
+/* Instance Pool */
+
+class InstancePool {
+
+    private:
+    /* blocks of memory - instances are placed one after another and never move */
+    std::vector<char*>* blocks_;
+    size_t used_, block_size_;
+
+    public:
+    /* constructor and destructor - instances must be destroyed before */
+    InstancePool(void);
+    ~InstancePool(void);
+    /* aligned memory for one instance */
+    void* allocate(size_t bytes);
+    /* make sure the next allocations of the given total size fit into the current block */
+    void reserve(size_t bytes);
+};
+
+
 /* Memory Compressor */
 
-class MemoryOverflow : public std::exception {
-    /* error message */
-    virtual const char* what(void) const throw() { return "Memory Overflow in Memory Copressor."; }
+/* chunk of memory covering [offset, offset + size) of the data of a compressor */
+struct MemoryChunk {
+    float* memory;
+    unsigned int offset, size;
+};
+
+/* immutable copy of the data of a compressor published to renderers */
+struct CompressorSnapshot {
+    /* contiguous copy of all chunks, capacity of the chunks and version it was taken at */
+    float* memory;
+    unsigned int size, capacity, version;
+    /* version at which each instance was last changed */
+    std::vector<unsigned int> changed;
+    /* instance tables - instances never move so their pointers stay valid */
+    std::vector<Compressable*> instances;
+    std::vector<unsigned int> type_ids, offsets, sizes;
+    /* epoch at which a newer snapshot replaced it */
+    unsigned int retired;
 };
 
 class MemCompressor {
 
     private:
-    /* memory */
-    float* memory_; 
+    /* memory - only read and written by the thread editing the scene */
+    /* chunks never move so instances keep their data pointers when the memory grows */
+    std::vector<MemoryChunk>* chunks_;
     float* memory_tail_;
     unsigned int memory_size_, filled_;
+    /* memory of instances */
+    InstancePool* pool_;
+    /* increased on every change to the stored data */
+    unsigned int version_;
+    /* version at which each instance was last changed */
+    std::vector<unsigned int>* changed_;
+    /* latest snapshot and replaced ones that may still be pinned */
+    std::atomic<CompressorSnapshot*> published_;
+    std::vector<CompressorSnapshot*>* retired_;
+    /* epoch based reclamation - the renderer announces the epoch it pinned at, zero while it pins nothing */
+    std::atomic<unsigned int> epoch_, reader_epoch_;
+    /* snapshot pinned by the renderer - null if none is pinned */
+    std::atomic<const CompressorSnapshot*> pinned_;
+    /* thread editing the data - writes of other threads are rejected */
+    std::atomic<std::thread::id> editor_;
+    /* pinned snapshot if the calling thread reads for the renderer, null otherwise */
+    const CompressorSnapshot* snapshot(void) const;
+    /* copy the data to a new snapshot unless nothing changed since the last one */
+    bool publish(void);
+    /* free retired snapshots the renderer can no longer read */
+    void reclaim(void);
     /* store all instances */
     std::vector<Compressable*>* instances_; 
     std::vector<unsigned int>* type_ids_;
+    /* offset and size of the data of each instance in memory */
+    std::vector<unsigned int>* offsets_;
+    std::vector<unsigned int>* sizes_;
 
     public:
     /* constructors and destructor */
-    MemCompressor(unsigned int mem_size);
+    MemCompressor(unsigned int chunk_size = MEM_COMPRESSOR_CHUNK_SIZE);
     ~MemCompressor(void);
-    /* getter */
-    float* data(void) const { return this->memory_; }
-    unsigned int filled(void) const { return this->filled_; }
-    Compressable* get(unsigned int id) const { return this->instances_->at(id); }
-    std::vector<Compressable*>* get_instances(void) const { return this->instances_; }
-    std::vector<unsigned int>* get_type_ids(void) const { return this->type_ids_; }
-    unsigned int n_instances(void) const { return this->instances_->size(); }
+    /* getter - contiguous data of the pinned snapshot, null unless the calling thread reads for the renderer */
+    const float* data(void) const;
+    /* sizes, instance tables and versions are those of the pinned snapshot as well on renderer threads */
+    unsigned int filled(void) const;
+    unsigned int size(void) const;
+    Compressable* get(unsigned int id) const { return this->get_instances()->at(id); }
+    const std::vector<Compressable*>* get_instances(void) const;
+    const std::vector<unsigned int>* get_type_ids(void) const;
+    const std::vector<unsigned int>* get_offsets(void) const;
+    unsigned int offset(unsigned int id) const { return this->get_offsets()->at(id); }
+    unsigned int n_instances(void) const { return this->get_instances()->size(); }
+    unsigned int version(void) const;
+    /* mark data of instance as changed - only within an edit */
+    void touch(unsigned int id);
+    /* writers - the calling thread may write until the edit ends, which publishes all writes as a new snapshot */
+    /* publishing copies the whole compressor, so edits should batch many writes */
+    /* edits never overlap, the scene serializes them */
+    void begin_edit(void);
+    void end_edit(void);
+    bool editing(void) const { return this->editor_.load() == std::this_thread::get_id(); }
+    /* renderer - pin the latest snapshot until unpinned without waiting for writers */
+    /* only one thread may pin at a time */
+    void pin(void);
+    void unpin(void);
+    /* make room for instances with the given total data size without further allocations */
+    void reserve(unsigned int n_floats, unsigned int n_instances, size_t n_bytes);
+    template<class T> void reserve(unsigned int n) {
+        // size of data and object of type
+        T obj;
+        this->reserve(n * obj.get_size(), n, n * sizeof(T));
+    }
+    /* data ranges (first index, size) changed after the given version */
+    void changed_ranges(unsigned int version, std::vector<std::pair<unsigned int, unsigned int>>* ranges) const;
     /* factory method */
     template<class T> T* make(void) {
         // TODO: force T to inherit from Compressable
-        // create instance of type
-        Compressable *obj = new T();
-        // check for space to store instance
-        if (this->filled_ + obj->get_size() <= this->memory_size_) {
-            // set up compressable
-            obj->id(this->instances_->size());
-            obj->data(this->memory_tail_);
-            // update memory-tail and filled index
-            this->memory_tail_ += obj->get_size();
-            this->filled_ += obj->get_size();
-            // add instance to vector
-            this->instances_->push_back(obj);
-            this->type_ids_->push_back(obj->get_type_id());
-        // handle memory overflow
-        } else throw MemoryOverflow();
+        // renderers must not see half added instances
+        if (!this->editing()) throw EditRequiredException();
+        // create instance of type in pool
+        Compressable *obj = new (this->pool_->allocate(sizeof(T))) T();
+        // make room for data of instance - grows by another chunk if needed
+        this->reserve(obj->get_size(), 0, 0);
+        // set up compressable
+        obj->id(this->instances_->size());
+        obj->offset(this->filled_);
+        obj->data(this->memory_tail_);
+        obj->compressor(this);
+        // update memory-tail and filled index
+        this->memory_tail_ += obj->get_size();
+        this->filled_ += obj->get_size();
+        // add instance to vector
+        this->instances_->push_back(obj);
+        this->type_ids_->push_back(obj->get_type_id());
+        this->offsets_->push_back(this->filled_ - obj->get_size());
+        this->sizes_->push_back(obj->get_size());
+        this->changed_->push_back(0);
+        this->touch(obj->id());
         // return object
         return (T*)obj;
     }
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <exception>
+
+// forward declarations
+namespace cl {
+    class Context;
+    class Device;
+    class Program;
+};
+
+/* directory of cached program binaries - relative to the working directory like the kernel sources */
+#define PROGRAM_CACHE_DIR "cache"
+
+/* path of cache file for a key - keys should contain everything the cached data depends on */
+std::string cache_path(const std::string& key, const char* extension);
+/* read data of a cache file written for key - false if the file is missing, truncated or belongs to another key */
+bool read_cache_file(const std::string& path, const std::string& key, std::string* data);
+/* write cache file through a temporary file renamed into place so readers never see a partial file */
+void write_cache_file(const std::string& path, const std::string& key, const char* data, size_t size);
+
+/* load program from the binary cache or build it from source and add its binary to the cache */
+/* binaries are keyed by device name, driver version, build options and a hash of the source and all files it includes */
+/* a cached binary the driver rejects falls back to a build from source */
+cl::Program* build_program(const cl::Context& context, const cl::Device& device, const std::string& source, const std::string& options);
+
+class ProgramBuildFailed : public std::exception {
+    public:
+    virtual const char* what(void) const throw() { return "OpenCL program failed to build."; }
+};
@@ -0,0 +1,17 @@
+#pragma once
+
+/* thread-local counter-based random number generation */
+/* the n-th number of a stream is a hash of the stream key and n - same generator as randf in src/kernels/utils.cl */
+
+/* generator state - lets interleaved work keep its own stream */
+struct RandomState { unsigned int key, counter; };
+
+// pcg output permutation of a 32 bit value
+unsigned int random_hash(unsigned int v);
+// start the stream of one sample of a pixel on the calling thread
+void seed_random(unsigned int seed, unsigned int pixel, unsigned int sample);
+// read and restore the state of the calling thread
+RandomState random_state(void);
+void random_state(RandomState state);
+// uniform random number in [0, 1)
+float randf(void);
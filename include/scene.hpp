@@ -1,5 +1,7 @@
 #include <vector>
+#include <mutex>
 #include "vec3f.hpp"
+#include "vec3f8.hpp"
 #include "memCompressor.hpp"
 
 // forward declarations
@@ -7,6 +9,10 @@ class Material;
 class Geometry;
 class Light; 
 class Camera;
+class BVH;
+class LightSampler;
+class MeshBuffer;
+class TriangleMesh;
 
 class Scene {
     private:
@@ -16,24 +22,64 @@ class Scene {
     MemCompressor* materialCompressor;
     MemCompressor* geometryCompressor;
     MemCompressor* lightCompressor;
+    /* shared vertices and indices of all triangle meshes */
+    MeshBuffer* meshBuffer;
+    /* acceleration structure over geometries */
+    BVH* bvh;
+    /* alias table to pick lights by power */
+    LightSampler* lightSampler;
     std::vector<Camera*> *cams;
-    /* ambient light */
-    Vec3f ambient_color;
+    /* ambient light and version of changes not covered by the compressors */
+    struct Settings {
+        Vec3f ambient_color;
+        unsigned int version = 0;
+    };
+    /* live settings of editors, settings published by the last edit and those pinned for the current frame */
+    Settings settings, published_settings;
+    mutable Settings pinned_settings;
+    /* guards the short copies into and out of the published settings */
+    mutable std::mutex settings_lock;
+    /* held by the thread editing the compressors and the depth of its nested edits - renderers never take it */
+    std::recursive_mutex edit_lock;
+    unsigned int edit_depth = 0;
     /* active camera */
     Camera* active_camera;
     /* scene members */
     const unsigned int id;
+    /* phong light of single light at point - black if the light is hidden */
+    Vec3f light_contribution(Light* light, Vec3f p, Vec3f vision_dir, Vec3f normal, Material* material) const;
+    /* add instance to compressor within an edit */
+    template<class T> unsigned int add(MemCompressor* compressor, Config* conf) {
+        this->begin_edit();
+        unsigned int id = compressor->make<T>(conf)->id();
+        this->end_edit();
+        return id;
+    }
 
     public:
     /* constructors and destructor*/
     Scene(void);
     ~Scene(void);
-    /* cast ray to scene */
-    bool cast(const Vec3f origin, const Vec3f dir, Geometry** geometry, float* t) const;
-    /* get light color at point */
-    Vec3f light_color(Vec3f p, Vec3f vision_dir, Vec3f normal, Material* material) const;
-    /* set ambient lightning */
+    /* cast ray to scene - returns hit geometry and index of hit primitive within it */
+    bool cast(const Vec3f origin, const Vec3f dir, Geometry** geometry, unsigned int* index, float* t) const;
+    /* check whether anything lies on the ray up to distance t_max - cheaper than cast for shadow rays */
+    bool occluded(const Vec3f origin, const Vec3f dir, float t_max) const;
+    /* cast packet of rays to scene - returns mask of hit lanes */
+    Float8 cast_packet(const Vec3f8& origin, const Vec3f8& dir, Float8 active, Geometry** geometry, unsigned int* index, Float8* t) const;
+    /* get light color at point - n_samples lights picked by power or all lights if zero */
+    Vec3f light_color(Vec3f p, Vec3f vision_dir, Vec3f normal, Material* material, unsigned int n_samples) const;
+    /* set ambient lightning - only within an edit */
     void ambient(Vec3f ambient);
+    /* every change to materials, geometries and lights happens within an edit on any thread */
+    /* edits nest and are published to renderers at once when the outermost one ends */
+    /* renderers only see instances of published snapshots so editors may add them during frames */
+    /* adding triangle meshes and cameras still happens between frames on the rendering thread */
+    void begin_edit(void);
+    void end_edit(void);
+    /* renderer - pin latest published snapshots of the compressors for a frame */
+    /* only reads of threads holding a RendererReads object see them */
+    void pin(void) const;
+    void unpin(void) const;
     /* add, get and activate cameras */
     unsigned int addCamera(void);
     void activateCamera(unsigned int);
@@ -43,15 +89,31 @@ class Scene {
     const MemCompressor* get_material_compressor(void) const { return this->materialCompressor; }
     const MemCompressor* get_geometry_compressor(void) const { return this->geometryCompressor; }
     const MemCompressor* get_light_compressor(void) const { return this->lightCompressor; }
+    /* get acceleration structure and mesh buffer */
+    BVH* get_bvh(void) const { return this->bvh; }
+    LightSampler* get_light_sampler(void) const { return this->lightSampler; }
+    const MeshBuffer* get_mesh_buffer(void) const { return this->meshBuffer; }
     /* read compressors */
     Material* get_material(unsigned int mat_id) const { return (Material*)this->materialCompressor->get(mat_id); }
     Geometry* get_geometry(unsigned int geo_id) const { return (Geometry*)this->geometryCompressor->get(geo_id); }
     Light* get_light(unsigned int light_id) const { return (Light*)this->lightCompressor->get(light_id); }
     /* getters */
-    Vec3f ambient(void) const { return this->ambient_color; }
+    /* ambient light - pinned one on renderer threads */
+    Vec3f ambient(void) const;
     const unsigned int get_id(void) const { return this->id; }
-    /* template methods */
-    template<class T> unsigned int addMaterial(Config* conf) { return this->materialCompressor->make<T>(conf)->id(); }
-    template<class T> unsigned int addGeometry(Config* conf) { return this->geometryCompressor->make<T>(conf)->id(); }
-    template<class T> unsigned int addLight(Config* conf) { return this->lightCompressor->make<T>(conf)->id(); }
-};
\ No newline at end of file
+    /* changes whenever anything affecting the rendered image changes */
+    unsigned int version(void) const;
+    /* template methods - each is an edit of its own unless called within an enclosing edit */
+    /* IMPORTANT: the outermost end_edit copies all data and instance tables of the compressors into new snapshots */
+    /* so adding n instances without an enclosing edit costs O(n^2) - wrap bulk loads in begin_edit and end_edit */
+    template<class T> unsigned int addMaterial(Config* conf) { return this->add<T>(this->materialCompressor, conf); }
+    template<class T> unsigned int addGeometry(Config* conf) { return this->add<T>(this->geometryCompressor, conf); }
+    template<class T> unsigned int addLight(Config* conf) { return this->add<T>(this->lightCompressor, conf); }
+    /* make room for n more instances of a type before adding them - also an edit of its own */
+    template<class T> void reserveMaterials(unsigned int n) { this->begin_edit(); this->materialCompressor->reserve<T>(n); this->end_edit(); }
+    template<class T> void reserveGeometries(unsigned int n) { this->begin_edit(); this->geometryCompressor->reserve<T>(n); this->end_edit(); }
+    template<class T> void reserveLights(unsigned int n) { this->begin_edit(); this->lightCompressor->reserve<T>(n); this->end_edit(); }
+};
+
+/* triangle meshes store their triangles in the shared mesh buffer of the scene */
+template<> unsigned int Scene::addGeometry<TriangleMesh>(Config* conf);
@@ -0,0 +1,14 @@
+#pragma once
+
+// forward declarations
+class Scene;
+
+/* example scenes - each adds and activates its own camera */
+void dielectric_scene(Scene* scene);
+void cornell_scene(Scene* scene);
+void triangle_scene(Scene* scene);
+/* procedural height field of 2 * n * n triangles - used to benchmark larger scenes */
+void terrain_scene(Scene* scene, unsigned int n);
+
+/* set up example scene by name - returns false for unknown names */
+bool load_scene(const char* name, Scene* scene);
@@ -0,0 +1,38 @@
+#pragma once
+#include <vector>
+#include "vec3f.hpp"
+#include "vec3f8.hpp"
+#include "memCompressor.hpp"
+
+// forward declarations
+struct BVHPrimitive;
+
+/* number of spheres tested at once - matches the lanes of an AVX2 register */
+#define SPHERE_STORE_WIDTH 8
+
+// Structure-of-arrays copy of all spheres in primitive order of a BVH
+// centers and radii are stored in four contiguous blocks of stride() floats each:
+//   x[0..stride) | y[0..stride) | z[0..stride) | r[0..stride)
+// entries of other primitives and the padding have a NaN radius so every test against them fails
+
+class SphereStore {
+
+    private:
+    /* all four blocks in one array so it can be uploaded as a single buffer */
+    std::vector<float>* data_;
+    unsigned int stride_;
+
+    public:
+    /* constructor and destructor */
+    SphereStore(void);
+    ~SphereStore(void);
+    /* gather spheres from the compressor in the order of the given primitives */
+    void build(const MemCompressor* geometries, const std::vector<BVHPrimitive>* prims);
+    /* closest sphere in [first, first + count) hit before t_max - returns its primitive index k and distance t */
+    bool cast(unsigned int first, unsigned int count, const Vec3f origin, const Vec3f dir, float t_max, unsigned int* k, float* t) const;
+    /* same test for a packet of rays - active lanes hitting a sphere before t update t and k, returns mask of those lanes */
+    Float8 cast_packet(unsigned int first, unsigned int count, const Vec3f8& origin, const Vec3f8& dir, Float8 active, Float8* t, unsigned int* k) const;
+    /* getters */
+    const std::vector<float>* data(void) const { return this->data_; }
+    unsigned int stride(void) const { return this->stride_; }
+};
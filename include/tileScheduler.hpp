@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+/* edge length of a square tile in pixels */
+#define TILE_SIZE 16
+
+// Tile
+
+struct Tile {
+    /* pixel range [x0, x1) x [y0, y1) */
+    unsigned int x0, y0, x1, y1;
+};
+
+// Tile Scheduler
+
+class TileScheduler {
+
+    private:
+    /* queue of tiles owned by one worker */
+    struct TileQueue {
+        std::mutex lock;
+        std::deque<Tile> tiles;
+    };
+    /* worker threads and their queues */
+    std::vector<std::thread>* workers;
+    std::vector<TileQueue*>* queues;
+    /* current job */
+    std::function<void(const Tile&)> job;
+    /* synchronization */
+    std::mutex state_lock;
+    std::condition_variable job_cv, done_cv;
+    unsigned int generation, n_done;
+    bool stop;
+
+    /* worker mainloop */
+    void work(unsigned int worker_id);
+    /* pop tile from own queue or steal one from another worker */
+    bool next_tile(unsigned int worker_id, Tile* tile);
+
+    public:
+    /* constructor and destructor */
+    TileScheduler(unsigned int n_threads);
+    ~TileScheduler(void);
+    /* getters */
+    unsigned int n_threads(void) const { return this->workers->size(); }
+    /* split image into tiles and process all of them - blocks until done */
+    void run(unsigned int w, unsigned int h, std::function<void(const Tile&)> job) { this->run(w, 0, h, job); }
+    /* same for rows [y0, y1) of the image only */
+    void run(unsigned int w, unsigned int y0, unsigned int y1, std::function<void(const Tile&)> job);
+};
@@ -2,22 +2,30 @@
 #define vec3f
 
 #include <iostream>
+#include <math.h>
+#include <xmmintrin.h>
 using namespace std;
 
+// three-float vector stored in one sse register - all arithmetic is inline
+// every operation computes the same lanes in the same order as plain float code
+
 class Vec3f {
     private:
-    /* coords */
-    float x_, y_, z_;
+    /* coords - fourth lane is padding */
+    alignas(16) float v_[4];
+    /* sse helpers */
+    __m128 load(void) const { return _mm_load_ps(this->v_); }
+    static Vec3f from(__m128 v) { Vec3f r; _mm_store_ps(r.v_, v); return r; }
 
     public:
     /* constructors */
-    Vec3f(void);
-    Vec3f(float x, float y, float z);
+    Vec3f(void): v_{0, 0, 0, 0} {}
+    Vec3f(float x, float y, float z): v_{x, y, z, 0} {}
     /* static constructors */
     static Vec3f rand_in_unit_sphere(void);
     /*  */
-    float sum(void) const;
-    float magnitude(void) const;
+    float sum(void) const { return this->v_[0] + this->v_[1] + this->v_[2]; }
+    float magnitude(void) const { return sqrtf(Vec3f::dot(*this, *this)); }
     /*  */
     Vec3f clamp(float a, float b) const;
     Vec3f normalize(void) const;
@@ -26,14 +34,14 @@ class Vec3f {
     bool refract(const Vec3f n, float ni_over_nt, Vec3f* refracted) const;
     /* vec-vec-operators */
     static Vec3f cross(const Vec3f a, const Vec3f b);
-    static Vec3f mul(const Vec3f a, const Vec3f b);
-    static Vec3f add(const Vec3f a, const Vec3f b);
-    static Vec3f sub(const Vec3f a, const Vec3f b);
-    static float dot(const Vec3f a, const Vec3f b);
+    static Vec3f mul(const Vec3f a, const Vec3f b) { return Vec3f::from(_mm_mul_ps(a.load(), b.load())); }
+    static Vec3f add(const Vec3f a, const Vec3f b) { return Vec3f::from(_mm_add_ps(a.load(), b.load())); }
+    static Vec3f sub(const Vec3f a, const Vec3f b) { return Vec3f::from(_mm_sub_ps(a.load(), b.load())); }
+    static float dot(const Vec3f a, const Vec3f b) { return Vec3f::mul(a, b).sum(); }
     /* vec-float-operators */
-    static Vec3f mul(const Vec3f a, const float b);
-    static Vec3f add(const Vec3f a, const float b);
-    static Vec3f sub(const Vec3f a, const float b);
+    static Vec3f mul(const Vec3f a, const float b) { return Vec3f::from(_mm_mul_ps(a.load(), _mm_set1_ps(b))); }
+    static Vec3f add(const Vec3f a, const float b) { return Vec3f::from(_mm_add_ps(a.load(), _mm_set1_ps(b))); }
+    static Vec3f sub(const Vec3f a, const float b) { return Vec3f::from(_mm_sub_ps(a.load(), _mm_set1_ps(b))); }
     /* vec-vec-overrides */
     Vec3f operator*(const Vec3f other) const { return Vec3f::mul(*this, other); }
     Vec3f operator+(const Vec3f other) const { return Vec3f::add(*this, other); }
@@ -43,13 +51,40 @@ class Vec3f {
     Vec3f operator+(const float other) const { return Vec3f::add(*this, other); }
     Vec3f operator-(const float other) const { return Vec3f::sub(*this, other); }
     /* getters */
-    float x(void) const { return this->x_; };
-    float y(void) const { return this->y_; };
-    float z(void) const { return this->z_; };
+    float x(void) const { return this->v_[0]; };
+    float y(void) const { return this->v_[1]; };
+    float z(void) const { return this->v_[2]; };
+    float operator[](unsigned int i) const { return this->v_[(i < 2)? i : 2]; }
     /* setters */
-    void x(float x) { this->x_ = x; }
-    void y(float y) { this->y_ = y; }
-    void z(float z) { this->z_ = z; }
+    void x(float x) { this->v_[0] = x; }
+    void y(float y) { this->v_[1] = y; }
+    void z(float z) { this->v_[2] = z; }
 }; 
 
+
+/*** inline methods ***/
+
+inline Vec3f Vec3f::cross(const Vec3f a, const Vec3f b) {
+    // cross-product of two vectors - (y, z, x) * (z, x, y) - (z, x, y) * (y, z, x)
+    __m128 a_yzx = _mm_shuffle_ps(a.load(), a.load(), _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 b_yzx = _mm_shuffle_ps(b.load(), b.load(), _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 a_zxy = _mm_shuffle_ps(a.load(), a.load(), _MM_SHUFFLE(3, 1, 0, 2));
+    __m128 b_zxy = _mm_shuffle_ps(b.load(), b.load(), _MM_SHUFFLE(3, 1, 0, 2));
+    return Vec3f::from(_mm_sub_ps(_mm_mul_ps(a_yzx, b_zxy), _mm_mul_ps(a_zxy, b_yzx)));
+}
+
+inline Vec3f Vec3f::normalize(void) const {
+    // compute norm
+    float norm_squarred = Vec3f::dot(*this, *this);
+    // scale by exactly one if already normalized - a select instead of a branch - and avoid division by zero
+    float scale = (fabsf(norm_squarred - 1) > 1e-5)? (float)(1 / (sqrtf(norm_squarred) + 1e-5)) : 1.0f;
+    // normalize all elements
+    return Vec3f::mul(*this, scale);
+}
+
+inline Vec3f Vec3f::clamp(float a, float b) const {
+    // create vector with clipped values
+    return Vec3f(min(max(a, this->x()), b), min(max(a, this->y()), b), min(max(a, this->z()), b));
+}
+
 #endif
@@ -0,0 +1,124 @@
+#pragma once
+#include "vec3f.hpp"
+#include <math.h>
+#include <string.h>
+#ifdef __AVX__
+#include <immintrin.h>
+#endif
+
+/* number of rays in a packet */
+#define PACKET_SIZE 8
+
+// eight floats processed together - one avx register, plain loops without avx
+// comparisons return masks with all bits of a lane set, masks combine with & and |
+
+class Float8 {
+    public:
+#ifdef __AVX__
+    __m256 v;
+    Float8(__m256 v): v(v) {}
+    Float8(void): v(_mm256_setzero_ps()) {}
+    Float8(float s): v(_mm256_set1_ps(s)) {}
+    static Float8 load(const float* p) { return _mm256_loadu_ps(p); }
+    void store(float* p) const { _mm256_storeu_ps(p, this->v); }
+    /* arithmetic */
+    Float8 operator+(const Float8 o) const { return _mm256_add_ps(this->v, o.v); }
+    Float8 operator-(const Float8 o) const { return _mm256_sub_ps(this->v, o.v); }
+    Float8 operator*(const Float8 o) const { return _mm256_mul_ps(this->v, o.v); }
+    Float8 operator/(const Float8 o) const { return _mm256_div_ps(this->v, o.v); }
+    /* comparisons */
+    Float8 operator<(const Float8 o) const { return _mm256_cmp_ps(this->v, o.v, _CMP_LT_OQ); }
+    Float8 operator>(const Float8 o) const { return _mm256_cmp_ps(this->v, o.v, _CMP_GT_OQ); }
+    Float8 operator<=(const Float8 o) const { return _mm256_cmp_ps(this->v, o.v, _CMP_LE_OQ); }
+    Float8 operator>=(const Float8 o) const { return _mm256_cmp_ps(this->v, o.v, _CMP_GE_OQ); }
+    Float8 operator==(const Float8 o) const { return _mm256_cmp_ps(this->v, o.v, _CMP_EQ_OQ); }
+    Float8 operator!=(const Float8 o) const { return _mm256_cmp_ps(this->v, o.v, _CMP_NEQ_UQ); }
+    /* masks */
+    Float8 operator&(const Float8 o) const { return _mm256_and_ps(this->v, o.v); }
+    Float8 operator|(const Float8 o) const { return _mm256_or_ps(this->v, o.v); }
+    Float8 andnot(const Float8 o) const { return _mm256_andnot_ps(o.v, this->v); }
+    int bits(void) const { return _mm256_movemask_ps(this->v); }
+    /* select a where mask is set and b otherwise */
+    static Float8 select(const Float8 mask, const Float8 a, const Float8 b) { return _mm256_blendv_ps(b.v, a.v, mask.v); }
+    static Float8 sqrt(const Float8 a) { return _mm256_sqrt_ps(a.v); }
+    static Float8 abs(const Float8 a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v); }
+    /* same as std::min(a, b) and std::max(a, b) of each lane */
+    static Float8 min(const Float8 a, const Float8 b) { return _mm256_min_ps(b.v, a.v); }
+    static Float8 max(const Float8 a, const Float8 b) { return _mm256_max_ps(b.v, a.v); }
+#else
+    float v[PACKET_SIZE];
+    Float8(void) { for (int i = 0; i < PACKET_SIZE; i++) this->v[i] = 0; }
+    Float8(float s) { for (int i = 0; i < PACKET_SIZE; i++) this->v[i] = s; }
+    static Float8 load(const float* p) { Float8 r; memcpy(r.v, p, sizeof(r.v)); return r; }
+    void store(float* p) const { memcpy(p, this->v, sizeof(this->v)); }
+    /* arithmetic */
+    Float8 operator+(const Float8 o) const { Float8 r; for (int i = 0; i < PACKET_SIZE; i++) r.v[i] = this->v[i] + o.v[i]; return r; }
+    Float8 operator-(const Float8 o) const { Float8 r; for (int i = 0; i < PACKET_SIZE; i++) r.v[i] = this->v[i] - o.v[i]; return r; }
+    Float8 operator*(const Float8 o) const { Float8 r; for (int i = 0; i < PACKET_SIZE; i++) r.v[i] = this->v[i] * o.v[i]; return r; }
+    Float8 operator/(const Float8 o) const { Float8 r; for (int i = 0; i < PACKET_SIZE; i++) r.v[i] = this->v[i] / o.v[i]; return r; }
+    /* comparisons */
+    Float8 operator<(const Float8 o) const { Float8 r; for (int i = 0; i < PACKET_SIZE; i++) r.v[i] = Float8::mask(this->v[i] < o.v[i]); return r; }
+    Float8 operator>(const Float8 o) const { Float8 r; for (int i = 0; i < PACKET_SIZE; i++) r.v[i] = Float8::mask(this->v[i] > o.v[i]); return r; }
+    Float8 operator<=(const Float8 o) const { Float8 r; for (int i = 0; i < PACKET_SIZE; i++) r.v[i] = Float8::mask(this->v[i] <= o.v[i]); return r; }
+    Float8 operator>=(const Float8 o) const { Float8 r; for (int i = 0; i < PACKET_SIZE; i++) r.v[i] = Float8::mask(this->v[i] >= o.v[i]); return r; }
+    Float8 operator==(const Float8 o) const { Float8 r; for (int i = 0; i < PACKET_SIZE; i++) r.v[i] = Float8::mask(this->v[i] == o.v[i]); return r; }
+    Float8 operator!=(const Float8 o) const { Float8 r; for (int i = 0; i < PACKET_SIZE; i++) r.v[i] = Float8::mask(this->v[i] != o.v[i]); return r; }
+    /* masks */
+    Float8 operator&(const Float8 o) const { Float8 r; for (int i = 0; i < PACKET_SIZE; i++) r.v[i] = Float8::mask(this->on(i) && o.on(i)); return r; }
+    Float8 operator|(const Float8 o) const { Float8 r; for (int i = 0; i < PACKET_SIZE; i++) r.v[i] = Float8::mask(this->on(i) || o.on(i)); return r; }
+    Float8 andnot(const Float8 o) const { Float8 r; for (int i = 0; i < PACKET_SIZE; i++) r.v[i] = Float8::mask(this->on(i) && !o.on(i)); return r; }
+    int bits(void) const { int b = 0; for (int i = 0; i < PACKET_SIZE; i++) b |= this->on(i) << i; return b; }
+    /* select a where mask is set and b otherwise */
+    static Float8 select(const Float8 mask, const Float8 a, const Float8 b) { Float8 r; for (int i = 0; i < PACKET_SIZE; i++) r.v[i] = mask.on(i)? a.v[i] : b.v[i]; return r; }
+    static Float8 sqrt(const Float8 a) { Float8 r; for (int i = 0; i < PACKET_SIZE; i++) r.v[i] = sqrtf(a.v[i]); return r; }
+    static Float8 abs(const Float8 a) { Float8 r; for (int i = 0; i < PACKET_SIZE; i++) r.v[i] = fabsf(a.v[i]); return r; }
+    /* same as std::min(a, b) and std::max(a, b) of each lane */
+    static Float8 min(const Float8 a, const Float8 b) { Float8 r; for (int i = 0; i < PACKET_SIZE; i++) r.v[i] = (b.v[i] < a.v[i])? b.v[i] : a.v[i]; return r; }
+    static Float8 max(const Float8 a, const Float8 b) { Float8 r; for (int i = 0; i < PACKET_SIZE; i++) r.v[i] = (a.v[i] < b.v[i])? b.v[i] : a.v[i]; return r; }
+    private:
+    /* lane masks are stored as floats with all bits set */
+    static float mask(bool on) { unsigned int b = on? 0xffffffffu : 0; float f; memcpy(&f, &b, sizeof(f)); return f; }
+    bool on(int i) const { unsigned int b; memcpy(&b, &this->v[i], sizeof(b)); return b != 0; }
+    public:
+#endif
+    /* read single lane */
+    float operator[](int i) const { float l[PACKET_SIZE]; this->store(l); return l[i]; }
+    /* any or all lanes of mask set */
+    bool any(void) const { return this->bits() != 0; }
+    bool all(void) const { return this->bits() == (1 << PACKET_SIZE) - 1; }
+};
+
+// packet of eight three-float vectors in structure-of-arrays layout
+
+class Vec3f8 {
+    public:
+    /* coords of all lanes */
+    Float8 x, y, z;
+    /* constructors */
+    Vec3f8(void) {}
+    Vec3f8(const Float8 x, const Float8 y, const Float8 z): x(x), y(y), z(z) {}
+    /* same vector in all lanes */
+    Vec3f8(const Vec3f v): x(v.x()), y(v.y()), z(v.z()) {}
+    /* gather from eight vectors */
+    static Vec3f8 gather(const Vec3f* v) {
+        float x[PACKET_SIZE], y[PACKET_SIZE], z[PACKET_SIZE];
+        for (int i = 0; i < PACKET_SIZE; i++) { x[i] = v[i].x(); y[i] = v[i].y(); z[i] = v[i].z(); }
+        return Vec3f8(Float8::load(x), Float8::load(y), Float8::load(z));
+    }
+    /* read single lane */
+    Vec3f operator[](int i) const { return Vec3f(this->x[i], this->y[i], this->z[i]); }
+    /* component of each lane given by axis index 0, 1 or 2 stored as float */
+    Float8 axis(const Float8 k) const { return Float8::select(k == Float8(0), this->x, Float8::select(k == Float8(1), this->y, this->z)); }
+    /* vec-vec-operators - same order of operations as Vec3f */
+    Vec3f8 operator+(const Vec3f8& o) const { return Vec3f8(this->x + o.x, this->y + o.y, this->z + o.z); }
+    Vec3f8 operator-(const Vec3f8& o) const { return Vec3f8(this->x - o.x, this->y - o.y, this->z - o.z); }
+    Vec3f8 operator*(const Vec3f8& o) const { return Vec3f8(this->x * o.x, this->y * o.y, this->z * o.z); }
+    static Float8 dot(const Vec3f8& a, const Vec3f8& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+    static Vec3f8 cross(const Vec3f8& a, const Vec3f8& b) { return Vec3f8(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x); }
+    /* vec-float-operators */
+    Vec3f8 operator*(const Float8 s) const { return Vec3f8(this->x * s, this->y * s, this->z * s); }
+    /* select a where mask is set and b otherwise */
+    static Vec3f8 select(const Float8 mask, const Vec3f8& a, const Vec3f8& b) {
+        return Vec3f8(Float8::select(mask, a.x, b.x), Float8::select(mask, a.y, b.y), Float8::select(mask, a.z, b.z));
+    }
+};
@@ -23,6 +23,8 @@ class Window{
     /* manipulate pixels */
     void* pixels(void) const;
     void display(void);
+    /* upload pixels owned by the caller and display them - no texture lock */
+    void display(const void* pixels);
     /* getters */
     const unsigned int get_id(void) const { return this->id; }
     const unsigned int get_width(void) const { return this->width; }
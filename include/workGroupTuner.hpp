@@ -0,0 +1,18 @@
+#pragma once
+#include <string>
+#include <functional>
+
+// forward declarations
+namespace cl {
+    class Device;
+    class Kernel;
+};
+
+/* shape of a 2d work-group - rows run along the first dimension of the range */
+struct WorkGroup {
+    unsigned int rows, cols;
+};
+
+/* fastest work-group shape of a 2d kernel on a device - read from the cache directory or measured once and stored */
+/* launch enqueues the kernel with the given shape and waits for it, key identifies the kernel build e.g. by its options */
+WorkGroup tune_work_group(const cl::Device& device, const cl::Kernel& kernel, const std::string& key, std::function<void(const WorkGroup&)> launch);
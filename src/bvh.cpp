@@ -0,0 +1,414 @@
+#include "bvh.hpp"
+#include "geometry.hpp"
+#include <algorithm>
+#include <limits>
+#include <math.h>
+
+using namespace std;
+
+/*** helpers ***/
+
+static float axis(const Vec3f v, unsigned int a) { return (a == 0)? v.x() : ((a == 1)? v.y() : v.z()); }
+static Vec3f vmin(const Vec3f a, const Vec3f b) { return Vec3f(fminf(a.x(), b.x()), fminf(a.y(), b.y()), fminf(a.z(), b.z())); }
+static Vec3f vmax(const Vec3f a, const Vec3f b) { return Vec3f(fmaxf(a.x(), b.x()), fmaxf(a.y(), b.y()), fmaxf(a.z(), b.z())); }
+
+static float surface_area(const Vec3f min, const Vec3f max) {
+    // half surface area is enough for cost comparisons
+    Vec3f d = max - min;
+    return d.x() * d.y() + d.y() * d.z() + d.z() * d.x();
+}
+
+static bool primitive_bounds(const Geometry* geo, unsigned int index, Vec3f* min, Vec3f* max) {
+    if (!geo->primitive_bounds(index, min, max)) return false;
+    // pad boxes so flat geometries and grazing rays are not lost to rounding
+    *min = *min - EPS; *max = *max + EPS;
+    return true;
+}
+
+static void set_bounds(BVHNode* node, const Vec3f min, const Vec3f max) {
+    node->bmin[0] = min.x(); node->bmin[1] = min.y(); node->bmin[2] = min.z();
+    node->bmax[0] = max.x(); node->bmax[1] = max.y(); node->bmax[2] = max.z();
+}
+
+static bool box_hit(const BVHNode& node, const Vec3f origin, const Vec3f inv_dir, float t_max) {
+    // slab test on all three axes
+    float t_enter = 0.0f, t_exit = t_max;
+    for (unsigned int a = 0; a < 3; a++) {
+        float t0 = (node.bmin[a] - axis(origin, a)) * axis(inv_dir, a);
+        float t1 = (node.bmax[a] - axis(origin, a)) * axis(inv_dir, a);
+        t_enter = fmaxf(t_enter, fminf(t0, t1));
+        t_exit = fminf(t_exit, fmaxf(t0, t1));
+    }
+    return t_enter <= t_exit;
+}
+
+// fminf and fmaxf of each lane - a NaN operand yields the other one
+static Float8 fmin8(const Float8 a, const Float8 b) { return Float8::select(b != b, a, Float8::min(b, a)); }
+static Float8 fmax8(const Float8 a, const Float8 b) { return Float8::select(b != b, a, Float8::max(b, a)); }
+
+static bool box_hit_packet(const BVHNode& node, const Vec3f8& origin, const Vec3f8& inv_dir, const Float8 t_max, const Float8 active) {
+    // slab test of each lane - the node is visited if any active lane hits it
+    Float8 t_enter(0.0f), t_exit = t_max;
+    const Float8* o[3] = { &origin.x, &origin.y, &origin.z };
+    const Float8* d[3] = { &inv_dir.x, &inv_dir.y, &inv_dir.z };
+    for (unsigned int a = 0; a < 3; a++) {
+        Float8 t0 = (Float8(node.bmin[a]) - *o[a]) * *d[a];
+        Float8 t1 = (Float8(node.bmax[a]) - *o[a]) * *d[a];
+        t_enter = fmax8(t_enter, fmin8(t0, t1));
+        t_exit = fmin8(t_exit, fmax8(t0, t1));
+    }
+    return ((t_enter <= t_exit) & active).any();
+}
+
+
+/*** constructors ***/
+
+BVH::BVH(const MemCompressor* geometries): geometries(geometries), n_unbounded_(0), n_built(0), version_built(0), version_(0) {
+    // create vectors
+    this->nodes_ = new vector<BVHNode>();
+    this->prims_ = new vector<BVHPrimitive>();
+    this->spheres_ = new SphereStore();
+}
+
+
+/*** destructor ***/
+
+BVH::~BVH(void) {
+    // delete vectors
+    delete this->nodes_;
+    delete this->prims_;
+    delete this->spheres_;
+}
+
+
+/*** build ***/
+
+void BVH::build(void) {
+    // clear previous hierarchy
+    this->nodes_->clear();
+    this->prims_->clear();
+    // collect primitives - unbounded ones are stored first and tested against every ray
+    vector<BuildPrimitive> items;
+    for (Compressable* e : *this->geometries->get_instances()) {
+        Geometry* geo = (Geometry*)e;
+        // data of geometries may be padded at the end of memory chunks
+        unsigned int offset = this->geometries->offset(geo->id());
+        for (unsigned int k = 0; k < geo->n_primitives(); k++) {
+            BuildPrimitive item; item.prim = { offset, geo->get_type_id(), geo->id(), k };
+            if (primitive_bounds(geo, k, &item.min, &item.max)) {
+                item.centroid = (item.min + item.max) * 0.5f;
+                items.push_back(item);
+            } else this->prims_->push_back(item.prim);
+        }
+    }
+    this->n_unbounded_ = this->prims_->size();
+    // build tree and thread it with skip links
+    if (!items.empty()) {
+        this->build_node(items, 0, items.size(), 0);
+        this->link(0, this->nodes_->size());
+        this->store_top_levels();
+    }
+    // store bounded primitives in leaf order
+    for (BuildPrimitive& item : items) { this->prims_->push_back(item.prim); }
+    this->spheres_->build(this->geometries, this->prims_);
+    // remember compressor state
+    this->n_built = this->geometries->n_instances();
+    this->version_built = this->geometries->version();
+    this->version_++;
+}
+
+unsigned int BVH::build_node(vector<BuildPrimitive>& items, unsigned int begin, unsigned int end, unsigned int depth) {
+    // add node - children are appended after their parent
+    unsigned int node_id = this->nodes_->size();
+    this->nodes_->push_back(BVHNode());
+    // bounds of primitives and their centroids
+    Vec3f bmin = items[begin].min, bmax = items[begin].max;
+    Vec3f cmin = items[begin].centroid, cmax = items[begin].centroid;
+    for (unsigned int i = begin + 1; i < end; i++) {
+        bmin = vmin(bmin, items[i].min); bmax = vmax(bmax, items[i].max);
+        cmin = vmin(cmin, items[i].centroid); cmax = vmax(cmax, items[i].centroid);
+    }
+    unsigned int n = end - begin;
+
+    // small enough for a leaf
+    if (n <= BVH_MAX_LEAF_SIZE) {
+        BVHNode* node = &this->nodes_->at(node_id);
+        set_bounds(node, bmin, bmax);
+        node->child = this->n_unbounded_ + begin;
+        node->count = n;
+        return node_id;
+    }
+
+    // find split with lowest surface area heuristic over binned centroids
+    int best_axis = -1; unsigned int best_bin = 0;
+    float best_cost = numeric_limits<float>::max();
+    for (unsigned int a = 0; (a < 3) && (depth < BVH_MAX_SAH_DEPTH); a++) {
+        float lo = axis(cmin, a), extent = axis(cmax, a) - lo;
+        if (extent <= 0) continue;
+        // fill bins
+        unsigned int counts[BVH_SAH_BINS] = { 0 };
+        Vec3f mins[BVH_SAH_BINS], maxs[BVH_SAH_BINS];
+        for (unsigned int i = begin; i < end; i++) {
+            unsigned int b = min((unsigned int)((axis(items[i].centroid, a) - lo) / extent * BVH_SAH_BINS), (unsigned int)BVH_SAH_BINS - 1);
+            mins[b] = (counts[b] == 0)? items[i].min : vmin(mins[b], items[i].min);
+            maxs[b] = (counts[b] == 0)? items[i].max : vmax(maxs[b], items[i].max);
+            counts[b]++;
+        }
+        // sweep from the right to collect costs of all right sides
+        float right_costs[BVH_SAH_BINS]; unsigned int n_right = 0;
+        Vec3f rmin, rmax;
+        for (unsigned int b = BVH_SAH_BINS - 1; b > 0; b--) {
+            if (counts[b] > 0) {
+                rmin = (n_right == 0)? mins[b] : vmin(rmin, mins[b]);
+                rmax = (n_right == 0)? maxs[b] : vmax(rmax, maxs[b]);
+                n_right += counts[b];
+            }
+            right_costs[b] = (n_right > 0)? surface_area(rmin, rmax) * n_right : 0;
+        }
+        // sweep from the left and evaluate splits in front of each bin
+        unsigned int n_left = 0;
+        Vec3f lmin, lmax;
+        for (unsigned int b = 1; b < BVH_SAH_BINS; b++) {
+            if (counts[b - 1] > 0) {
+                lmin = (n_left == 0)? mins[b - 1] : vmin(lmin, mins[b - 1]);
+                lmax = (n_left == 0)? maxs[b - 1] : vmax(lmax, maxs[b - 1]);
+                n_left += counts[b - 1];
+            }
+            // both sides need primitives
+            if ((n_left == 0) || (n_left == n)) continue;
+            float cost = surface_area(lmin, lmax) * n_left + right_costs[b];
+            if (cost < best_cost) { best_cost = cost; best_axis = a; best_bin = b; }
+        }
+    }
+
+    // partition primitives
+    unsigned int mid;
+    if (best_axis >= 0) {
+        float lo = axis(cmin, best_axis), extent = axis(cmax, best_axis) - lo;
+        mid = partition(items.begin() + begin, items.begin() + end, [&](const BuildPrimitive& item) {
+            unsigned int b = min((unsigned int)((axis(item.centroid, best_axis) - lo) / extent * BVH_SAH_BINS), (unsigned int)BVH_SAH_BINS - 1);
+            return b < best_bin;
+        }) - items.begin();
+    } else {
+        // no usable split - median along largest centroid extent
+        Vec3f d = cmax - cmin;
+        unsigned int a = (d.x() > d.y())? ((d.x() > d.z())? 0 : 2) : ((d.y() > d.z())? 1 : 2);
+        mid = begin + n / 2;
+        nth_element(items.begin() + begin, items.begin() + mid, items.begin() + end, [&](const BuildPrimitive& l, const BuildPrimitive& r) {
+            return axis(l.centroid, a) < axis(r.centroid, a);
+        });
+    }
+
+    // build children - the sibling is temporarily stored as skip of the first child
+    unsigned int left = this->build_node(items, begin, mid, depth + 1);
+    unsigned int right = this->build_node(items, mid, end, depth + 1);
+    this->nodes_->at(left).skip = right;
+    // set up inner node
+    BVHNode* node = &this->nodes_->at(node_id);
+    set_bounds(node, bmin, bmax);
+    node->child = left;
+    node->count = 0;
+    return node_id;
+}
+
+void BVH::link(unsigned int node_id, unsigned int skip) {
+    BVHNode* node = &this->nodes_->at(node_id);
+    // leaves only need their skip link
+    if (node->count == 0) {
+        // first child continues with its sibling which continues with the skip of the parent
+        unsigned int left = node->child;
+        unsigned int right = this->nodes_->at(left).skip;
+        this->link(left, right);
+        this->link(right, skip);
+    }
+    node->skip = skip;
+}
+
+void BVH::store_top_levels(void) {
+    unsigned int n = this->nodes_->size();
+    // collect nodes of the top levels breadth-first starting at the root
+    vector<unsigned int> order, level(1, 0);
+    vector<bool> top(n, false);
+    for (unsigned int d = 0; (d < BVH_TOP_LEVELS) && !level.empty(); d++) {
+        vector<unsigned int> next;
+        for (unsigned int i : level) {
+            order.push_back(i); top[i] = true;
+            const BVHNode& node = this->nodes_->at(i);
+            if (node.count == 0) { next.push_back(node.child); next.push_back(this->nodes_->at(node.child).skip); }
+        }
+        level.swap(next);
+    }
+    // all other nodes keep their depth-first order - children stay behind their parent
+    for (unsigned int i = 0; i < n; i++) { if (!top[i]) order.push_back(i); }
+    // move nodes and follow links to their new position - the skip past the last node stays the same
+    vector<unsigned int> moved(n + 1, n);
+    for (unsigned int k = 0; k < n; k++) { moved[order[k]] = k; }
+    vector<BVHNode> nodes(n);
+    for (unsigned int k = 0; k < n; k++) {
+        nodes[k] = this->nodes_->at(order[k]);
+        nodes[k].skip = moved[nodes[k].skip];
+        if (nodes[k].count == 0) nodes[k].child = moved[nodes[k].child];
+    }
+    this->nodes_->swap(nodes);
+}
+
+
+/*** refit ***/
+
+void BVH::refit(void) {
+    // children are always stored after their parent
+    for (int i = (int)this->nodes_->size() - 1; i >= 0; i--) {
+        BVHNode* node = &this->nodes_->at(i);
+        Vec3f bmin, bmax;
+        if (node->count > 0) {
+            // leaf - union of primitive bounds
+            for (unsigned int k = 0; k < node->count; k++) {
+                Vec3f pmin, pmax;
+                const BVHPrimitive& prim = this->prims_->at(node->child + k);
+                primitive_bounds((Geometry*)this->geometries->get(prim.id), prim.index, &pmin, &pmax);
+                bmin = (k == 0)? pmin : vmin(bmin, pmin);
+                bmax = (k == 0)? pmax : vmax(bmax, pmax);
+            }
+        } else {
+            // inner node - union of both children
+            const BVHNode& l = this->nodes_->at(node->child);
+            const BVHNode& r = this->nodes_->at(l.skip);
+            bmin = vmin(Vec3f(l.bmin[0], l.bmin[1], l.bmin[2]), Vec3f(r.bmin[0], r.bmin[1], r.bmin[2]));
+            bmax = vmax(Vec3f(l.bmax[0], l.bmax[1], l.bmax[2]), Vec3f(r.bmax[0], r.bmax[1], r.bmax[2]));
+        }
+        set_bounds(node, bmin, bmax);
+    }
+    // spheres may have moved as well
+    this->spheres_->build(this->geometries, this->prims_);
+    // remember compressor state
+    this->version_built = this->geometries->version();
+    this->version_++;
+}
+
+void BVH::update(void) {
+    // added geometries change the topology
+    if (this->n_built != this->geometries->n_instances()) this->build();
+    // changed geometries only move bounding boxes
+    else if (this->version_built != this->geometries->version()) this->refit();
+}
+
+
+/*** cast ***/
+
+void BVH::cast_primitive(const BVHPrimitive& prim, const Vec3f origin, const Vec3f dir, Geometry** geometry, unsigned int* index, float* t, bool* hit) const {
+    // cast to primitive and check if it is closer
+    Geometry* geo = (Geometry*)this->geometries->get(prim.id);
+    float t_;
+    if (geo->primitive_cast(prim.index, origin, dir, &t_) && (t_ < *t)) { *hit = true; *t = t_; *geometry = geo; *index = prim.index; }
+}
+
+bool BVH::cast(const Vec3f origin, const Vec3f dir, Geometry** geometry, unsigned int* index, float* t) const {
+    bool hit = false;
+    *t = numeric_limits<float>::max();
+    // unbounded geometries are tested against every ray
+    for (unsigned int i = 0; i < this->n_unbounded_; i++) { this->cast_primitive(this->prims_->at(i), origin, dir, geometry, index, t, &hit); }
+    // walk the hierarchy without a stack by following child and skip links
+    Vec3f inv_dir(1.0f / dir.x(), 1.0f / dir.y(), 1.0f / dir.z());
+    unsigned int i = 0, n = this->nodes_->size();
+    while (i < n) {
+        const BVHNode& node = (*this->nodes_)[i];
+        // skip subtree on miss
+        if (!box_hit(node, origin, inv_dir, *t)) { i = node.skip; continue; }
+        // descend into inner node
+        if (node.count == 0) { i = node.child; continue; }
+        // test all spheres of leaf at once
+        unsigned int s; float t_;
+        if (this->spheres_->cast(node.child, node.count, origin, dir, *t, &s, &t_)) {
+            const BVHPrimitive& prim = (*this->prims_)[s];
+            hit = true; *t = t_; *geometry = (Geometry*)this->geometries->get(prim.id); *index = prim.index;
+        }
+        // test remaining primitives of leaf one by one
+        for (unsigned int k = 0; k < node.count; k++) {
+            const BVHPrimitive& prim = (*this->prims_)[node.child + k];
+            if (prim.type_id != GEOMETRY_SPHERE_TYPE_ID) this->cast_primitive(prim, origin, dir, geometry, index, t, &hit);
+        }
+        i = node.skip;
+    }
+    // return hit
+    return hit;
+}
+
+bool BVH::primitive_blocks(const BVHPrimitive& prim, const Vec3f origin, const Vec3f dir, float t_max) const {
+    // cast to primitive and check if it lies before t_max
+    Geometry* geo = (Geometry*)this->geometries->get(prim.id);
+    float t;
+    return geo->primitive_cast(prim.index, origin, dir, &t) && (t <= t_max);
+}
+
+bool BVH::occluded(const Vec3f origin, const Vec3f dir, float t_max) const {
+    // unbounded geometries are tested against every ray
+    for (unsigned int i = 0; i < this->n_unbounded_; i++) { if (this->primitive_blocks(this->prims_->at(i), origin, dir, t_max)) return true; }
+    // same walk as cast but boxes beyond t_max are culled from the start and the first hit ends it
+    Vec3f inv_dir(1.0f / dir.x(), 1.0f / dir.y(), 1.0f / dir.z());
+    unsigned int i = 0, n = this->nodes_->size();
+    while (i < n) {
+        const BVHNode& node = (*this->nodes_)[i];
+        if (!box_hit(node, origin, inv_dir, t_max)) { i = node.skip; continue; }
+        if (node.count == 0) { i = node.child; continue; }
+        // any sphere of leaf
+        unsigned int s; float t;
+        if (this->spheres_->cast(node.child, node.count, origin, dir, t_max, &s, &t)) return true;
+        // remaining primitives of leaf
+        for (unsigned int k = 0; k < node.count; k++) {
+            const BVHPrimitive& prim = (*this->prims_)[node.child + k];
+            if ((prim.type_id != GEOMETRY_SPHERE_TYPE_ID) && this->primitive_blocks(prim, origin, dir, t_max)) return true;
+        }
+        i = node.skip;
+    }
+    return false;
+}
+
+void BVH::cast_primitive_packet(const BVHPrimitive& prim, const Vec3f8& origin, const Vec3f8& dir, Float8 active, Geometry** geometry, unsigned int* index, Float8* t, Float8* hit) const {
+    // cast packet to primitive and update lanes where it is closer
+    Geometry* geo = (Geometry*)this->geometries->get(prim.id);
+    Float8 t_;
+    Float8 closer = geo->primitive_cast_packet(prim.index, origin, dir, &t_);
+    closer = closer & (t_ < *t) & active;
+    int bits = closer.bits();
+    if (bits == 0) return;
+    *t = Float8::select(closer, t_, *t);
+    *hit = *hit | closer;
+    for (unsigned int l = 0; l < PACKET_SIZE; l++) {
+        if (bits & (1 << l)) { geometry[l] = geo; index[l] = prim.index; }
+    }
+}
+
+Float8 BVH::cast_packet(const Vec3f8& origin, const Vec3f8& dir, Float8 active, Geometry** geometry, unsigned int* index, Float8* t) const {
+    Float8 hit(0.0f);
+    *t = Float8(numeric_limits<float>::max());
+    // unbounded geometries are tested against every packet
+    for (unsigned int i = 0; i < this->n_unbounded_; i++) { this->cast_primitive_packet(this->prims_->at(i), origin, dir, active, geometry, index, t, &hit); }
+    // same stackless walk as single rays - nodes are visited while any lane needs them
+    Vec3f8 inv_dir(Float8(1.0f) / dir.x, Float8(1.0f) / dir.y, Float8(1.0f) / dir.z);
+    unsigned int i = 0, n = this->nodes_->size();
+    while (i < n) {
+        const BVHNode& node = (*this->nodes_)[i];
+        // skip subtree if all lanes miss
+        if (!box_hit_packet(node, origin, inv_dir, *t, active)) { i = node.skip; continue; }
+        // descend into inner node
+        if (node.count == 0) { i = node.child; continue; }
+        // test packet against all spheres of leaf with the same arithmetic as single rays
+        unsigned int s[PACKET_SIZE];
+        Float8 closer = this->spheres_->cast_packet(node.child, node.count, origin, dir, active, t, s);
+        int bits = closer.bits();
+        if (bits != 0) {
+            hit = hit | closer;
+            for (unsigned int l = 0; l < PACKET_SIZE; l++) {
+                if (bits & (1 << l)) { const BVHPrimitive& prim = (*this->prims_)[s[l]]; geometry[l] = (Geometry*)this->geometries->get(prim.id); index[l] = prim.index; }
+            }
+        }
+        // test remaining primitives of leaf one by one
+        for (unsigned int k = 0; k < node.count; k++) {
+            const BVHPrimitive& prim = (*this->prims_)[node.child + k];
+            if (prim.type_id != GEOMETRY_SPHERE_TYPE_ID) this->cast_primitive_packet(prim, origin, dir, active, geometry, index, t, &hit);
+        }
+        i = node.skip;
+    }
+    // return hit lanes
+    return hit;
+}
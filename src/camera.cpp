@@ -1,5 +1,4 @@
 // external
-#include "SDL2/SDL.h"
 #include "CL/cl2.hpp"
 // internal
 #include "camera.hpp"
@@ -7,19 +6,118 @@
 #include "geometry.hpp"
 #include "material.hpp"
 #include "light.hpp"
+#include "bvh.hpp"
+#include "lightSampler.hpp"
+#include "deviceBuffer.hpp"
+#include "random.hpp"
+#include "tileScheduler.hpp"
+#include "programCache.hpp"
+#include "workGroupTuner.hpp"
 // standard
 #include <tuple>
 #include <iostream>
 #include <fstream>
 #include <math.h>
-#include <time.h>
+#include <chrono>
+#include <cstring>
+#include <sstream>
 
 using namespace std;
 using namespace cl;
 
+/*** helpers ***/
+
+static double seconds_since(chrono::steady_clock::time_point start) {
+    // wall time - clock() would sum up the cpu time of all threads
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+static unsigned int round_up(unsigned int n, unsigned int multiple) {
+    return (n + multiple - 1) / multiple * multiple;
+}
+
+static void add_type_flags(ostringstream& options, const MemCompressor* compressor, const char* const* flags, unsigned int n_types) {
+    // one flag per type id used by any instance
+    std::vector<bool> used(n_types, false);
+    for (unsigned int t : *compressor->get_type_ids()) { if (t < n_types) used[t] = true; }
+    for (unsigned int t = 0; t < n_types; t++) { if (used[t]) options << " -D " << flags[t]; }
+}
+
+
+/*** wavefront pipeline ***/
+
+struct Wavefront {
+    /* kernels of all stages - shading kernels are indexed by material type id */
+    Kernel generate, intersect, shade[MATERIAL_N_TYPES], shadow, finish;
+    /* one path per pixel and the sum of its sample colors */
+    Buffer paths, sample_sum;
+    /* ray queues of current and next bounce, one queue per material type and queue of shaded paths */
+    Buffer queues[2], material_queues, shadow_queue;
+    /* counters of next ray queue and material queues */
+    Buffer counters;
+    /* number of pixels the buffers were created for */
+    unsigned int n;
+
+    Wavefront(const Program& program, const Context& context, CommandQueue& queue, unsigned int n): n(n) {
+        // create kernels
+        const char* shade_names[MATERIAL_N_TYPES] = { "wavefront_shade_diffuse", "wavefront_shade_metal", "wavefront_shade_dielectric" };
+        this->generate = Kernel(program, "wavefront_generate");
+        this->intersect = Kernel(program, "wavefront_intersect");
+        for (unsigned int t = 0; t < MATERIAL_N_TYPES; t++) { this->shade[t] = Kernel(program, shade_names[t]); }
+        this->shadow = Kernel(program, "wavefront_shadow");
+        this->finish = Kernel(program, "wavefront_finish");
+        // ask device for size of path struct
+        unsigned int path_size;
+        Buffer size_buf(context, CL_MEM_WRITE_ONLY, sizeof(unsigned int));
+        Kernel size_kern(program, "wavefront_get_path_size");
+        size_kern.setArg(0, size_buf);
+        queue.enqueueNDRangeKernel(size_kern, cl::NullRange, cl::NDRange(1));
+        queue.enqueueReadBuffer(size_buf, CL_TRUE, 0, sizeof(unsigned int), &path_size);
+        // create buffers
+        this->paths = Buffer(context, CL_MEM_READ_WRITE, n * path_size);
+        this->sample_sum = Buffer(context, CL_MEM_READ_WRITE, n * 3 * sizeof(float));
+        for (unsigned int k = 0; k < 2; k++) { this->queues[k] = Buffer(context, CL_MEM_READ_WRITE, n * sizeof(unsigned int)); }
+        this->material_queues = Buffer(context, CL_MEM_READ_WRITE, MATERIAL_N_TYPES * n * sizeof(unsigned int));
+        this->shadow_queue = Buffer(context, CL_MEM_READ_WRITE, n * sizeof(unsigned int));
+        this->counters = Buffer(context, CL_MEM_READ_WRITE, (1 + MATERIAL_N_TYPES) * sizeof(unsigned int));
+    }
+};
+
+/*** frame pipeline ***/
+
+struct FramePipeline {
+    /* pinned host buffers - frame k is read back into slot k % n_slots */
+    Buffer slots[MAX_FRAMES_IN_FLIGHT];
+    void* host[MAX_FRAMES_IN_FLIGHT];
+    /* completion of the readback of each slot */
+    Event ready[MAX_FRAMES_IN_FLIGHT];
+    unsigned int n_slots;
+    /* number of frames read back so far and bytes per frame */
+    unsigned int n_frames;
+    size_t bytes;
+    CommandQueue& queue;
+
+    FramePipeline(const Context& context, CommandQueue& queue, unsigned int n_slots, size_t bytes): n_slots(n_slots), n_frames(0), bytes(bytes), queue(queue) {
+        // allocate host memory the device can copy to directly and keep it mapped
+        for (unsigned int k = 0; k < n_slots; k++) {
+            this->slots[k] = Buffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, bytes);
+            this->host[k] = queue.enqueueMapBuffer(this->slots[k], CL_TRUE, CL_MAP_READ | CL_MAP_WRITE, 0, bytes);
+        }
+    }
+    ~FramePipeline(void) {
+        // wait for pending readbacks before releasing their memory
+        this->queue.finish();
+        for (unsigned int k = 0; k < this->n_slots; k++) { this->queue.enqueueUnmapMemObject(this->slots[k], this->host[k]); }
+        this->queue.finish();
+    }
+};
+
 /*** constructors ***/
 
-Camera::Camera(Scene* scene, unsigned int id): scene(scene), id(id) {}
+Camera::Camera(const Scene* scene, unsigned int id): scene(scene), id(id) {
+    // use all available cores for cpu rendering by default
+    this->n_threads_ = thread::hardware_concurrency();
+}
 
 
 /*** destructors ***/
@@ -27,41 +125,134 @@ Camera::Camera(Scene* scene, unsigned int id): scene(scene), id(id) {}
 Camera::~Camera(void) {
     // log
     cout << "Destroyed camera " << this->id << " of scene " << this->scene->get_id() << endl;
+    // stop cpu worker threads
+    delete this->scheduler;
+    // free accumulated samples
+    delete[] this->accum;
+    delete[] this->stats;
+    // destroy cameras of bands
+    if (this->bands != nullptr) {
+        for (Camera* band : *this->bands) { delete band; }
+        delete this->bands;
+        delete this->band_rows;
+        delete this->band_speed;
+    }
     // destroy opencl if assigned
     if (this->openCL_assigned) {
+        for (pair<const string, Program*>& p : *this->programs) { delete p.second; }
+        delete this->programs;
+        delete this->source;
+        delete this->device;
         delete this->context;
         delete this->queue;
-        delete this->program;
     }
 }
 
 /*** assign ***/
 
 void Camera::assign(const Device device) {
-    // save reference to device
-    this->device = &device;
+    // keep own copy of device - the argument only lives during this call
+    this->device = new Device(device);
     // create context and command-queue from device
     cl_int err_;
     this->context = new cl::Context(device);
     this->queue = new cl::CommandQueue(*this->context);
+    this->local_mem_size = device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>();
     // log
     cout << "Camera " << this->id << " using device " << this->device->getInfo<CL_DEVICE_NAME>() << endl;
-    // load opencl source files
+    // load opencl source files - programs are built once the scene features are known
     std::ifstream ray_source_file("src/kernels/camera.cl");
-    cl::string ray_src(std::istreambuf_iterator<char>(ray_source_file), (std::istreambuf_iterator<char>()));
-    // create program
-    cl::Program::Sources source{ray_src};
-    this->program = new cl::Program(*this->context, source);
-    // build program
-    if (this->program->build() != CL_BUILD_SUCCESS) {
-        // show build log
-        cout << this->program->getBuildInfo<CL_PROGRAM_BUILD_LOG>(*this->device) << endl;
-        throw;
-    } else { cout << "Program build successful" << endl; }
+    this->source = new string(std::istreambuf_iterator<char>(ray_source_file), (std::istreambuf_iterator<char>()));
+    this->programs = new map<string, Program*>();
     // set assigned
     this->openCL_assigned = true;
 }
 
+void Camera::assign(const std::vector<Device>& devices, bool cpu) {
+    // a single device or the cpu alone renders whole frames
+    if (devices.size() + (cpu? 1 : 0) < 2) { if (!devices.empty()) this->assign(devices[0]); return; }
+    // one camera per band - the cpu band comes last
+    this->bands = new std::vector<Camera*>();
+    for (const Device& device : devices) {
+        Camera* band = new Camera(this->scene, this->id);
+        band->assign(device);
+        this->bands->push_back(band);
+    }
+    if (cpu) {
+        this->bands->push_back(new Camera(this->scene, this->id));
+        cout << "Camera " << this->id << " using cpu" << endl;
+    }
+    // rows are split evenly on the first frame
+    this->band_rows = new std::vector<unsigned int>(this->bands->size() + 1, 0);
+    this->band_speed = new std::vector<double>(this->bands->size(), 0.0);
+}
+
+
+/*** programs ***/
+
+void Camera::plan_local_memory(bool* staged, unsigned int* n_nodes) const {
+    // bytes of data and instance table of geometries, materials and lights
+    const MemCompressor* compressors[3] = { this->scene->get_geometry_compressor(), this->scene->get_material_compressor(), this->scene->get_light_compressor() };
+    size_t bytes[3];
+    for (unsigned int k = 0; k < 3; k++) { bytes[k] = compressors[k]->filled() * sizeof(float) + 2 * compressors[k]->n_instances() * sizeof(unsigned int); }
+    size_t available = (this->local_mem_size > LOCAL_MEM_RESERVE)? this->local_mem_size - LOCAL_MEM_RESERVE : 0;
+    // hottest data first - materials are read at every hit and the top bvh levels by every ray
+    staged[1] = (bytes[1] <= available); if (staged[1]) available -= bytes[1];
+    *n_nodes = (unsigned int)min((size_t)(1u << BVH_TOP_LEVELS) - 1, available / sizeof(BVHNode));
+    available -= *n_nodes * sizeof(BVHNode);
+    // lights are read at every shading point, geometries only by the hit primitives
+    staged[2] = (bytes[2] <= available); if (staged[2]) available -= bytes[2];
+    staged[0] = (bytes[0] <= available);
+}
+
+string Camera::build_options(void) const {
+    // compile only the types present in the scene
+    static const char* geometry_flags[GEOMETRY_N_TYPES] = { "GEOMETRY_SPHERE_ENABLED", "GEOMETRY_PLANE_ENABLED", "GEOMETRY_TRIANGLE_ENABLED", "GEOMETRY_TRIANGLEMESH_ENABLED" };
+    static const char* material_flags[MATERIAL_N_TYPES] = { "MATERIAL_DIFFUSE_ENABLED", "MATERIAL_METAL_ENABLED", "MATERIAL_DIELECTRIC_ENABLED" };
+    static const char* light_flags[LIGHT_N_TYPES] = { "LIGHT_POINTLIGHT_ENABLED" };
+    ostringstream options;
+    options << "-D SCENE_FEATURES";
+    add_type_flags(options, this->scene->get_geometry_compressor(), geometry_flags, GEOMETRY_N_TYPES);
+    add_type_flags(options, this->scene->get_material_compressor(), material_flags, MATERIAL_N_TYPES);
+    add_type_flags(options, this->scene->get_light_compressor(), light_flags, LIGHT_N_TYPES);
+    // data that does not fit into local memory is read from global memory
+    static const char* global_flags[3] = { "GEOMETRY_IN_GLOBAL", "MATERIAL_IN_GLOBAL", "LIGHT_IN_GLOBAL" };
+    for (unsigned int k = 0; k < 3; k++) { if (!this->local_staged[k]) options << " -D " << global_flags[k]; }
+    // fixed loop counts
+    options << " -D MAX_RECURSION_DEPTH=" << MAX_RECURSION_DEPTH << " -D ANTIALIASING_N_SAMPLES=" << this->n_samples;
+    // pixels take varying sample counts
+    if (this->adaptive_threshold_ > 0) options << " -D ADAPTIVE_SAMPLING";
+    // lights are only sampled when it saves shadow rays
+    if ((this->light_samples_ > 0) && (this->light_samples_ < this->scene->get_light_compressor()->n_instances())) options << " -D LIGHT_SAMPLES=" << this->light_samples_;
+    return options.str();
+}
+
+Program* Camera::get_program(const string& options) {
+    // reuse program built for same options
+    map<string, Program*>::iterator it = this->programs->find(options);
+    if (it != this->programs->end()) return it->second;
+    // load binary from disk or build from source
+    Program* program = build_program(*this->context, *this->device, *this->source, options);
+    // keep program for this session
+    (*this->programs)[options] = program;
+    return program;
+}
+
+void Camera::select_program(void) {
+    // fit scene into local memory of device
+    this->plan_local_memory(this->local_staged, &this->n_local_nodes);
+    // nothing to do while the scene features stay the same
+    string options = this->build_options();
+    if ((this->program != nullptr) && (options == this->program_options)) return;
+    this->program = this->get_program(options);
+    this->program_options = options;
+    // kernels of previous program
+    if (this->kern != nullptr) { delete this->kern; this->kern = new Kernel(*this->program, "camera_get_pixel_color"); }
+    delete this->wf; this->wf = nullptr;
+    // the new kernel may prefer another work-group shape
+    this->group_rows = this->group_cols = 0;
+}
+
 /*** transform ***/
 
 void Camera::transform(Vec3f pos, Vec3f dir, Vec3f up) {
@@ -69,61 +260,136 @@ void Camera::transform(Vec3f pos, Vec3f dir, Vec3f up) {
 }
 
 /*** setters ***/
-void Camera::position(Vec3f pos) { this->pos_ = pos; }
-void Camera::direction(Vec3f dir) { this->dir_ = dir.normalize(); this->left_ = Vec3f::cross(this->dir_, this->up_); }
-void Camera::up(Vec3f up) { this->up_ = up.normalize(); this->left_ = Vec3f::cross(this->dir_, this->up_); }
-void Camera::FOV(float FOV) { this->FOV_ = FOV*3.14159265/180; }
-void Camera::antialiasing(unsigned int n_samples) { this->n_samples = n_samples; }
+// every change of the view invalidates the accumulated samples
+void Camera::position(Vec3f pos) { this->pos_ = pos; this->reset_accumulation(); }
+void Camera::direction(Vec3f dir) { this->dir_ = dir.normalize(); this->left_ = Vec3f::cross(this->dir_, this->up_); this->reset_accumulation(); }
+void Camera::up(Vec3f up) { this->up_ = up.normalize(); this->left_ = Vec3f::cross(this->dir_, this->up_); this->reset_accumulation(); }
+void Camera::FOV(float FOV) { this->FOV_ = FOV*3.14159265/180; this->reset_accumulation(); }
+void Camera::antialiasing(unsigned int n_samples) { this->n_samples = n_samples; this->reset_accumulation(); }
+void Camera::light_samples(unsigned int n_samples) { this->light_samples_ = n_samples; this->reset_accumulation(); }
+void Camera::adaptive(float threshold, unsigned int min_samples, unsigned int max_samples) {
+    this->adaptive_threshold_ = max(threshold, 0.0f);
+    this->adaptive_min_samples_ = max(min_samples, 2u); this->adaptive_max_samples_ = max_samples;
+    this->reset_accumulation();
+}
+void Camera::seed(unsigned int seed) { this->seed_ = seed; this->reset_accumulation(); }
+void Camera::wavefront(bool enabled) { this->wavefront_ = enabled; this->reset_accumulation(); }
+void Camera::frames_in_flight(unsigned int n_frames) {
+    // frames already in flight are dropped
+    this->frames_in_flight_ = min(max(n_frames, 1u), (unsigned int)MAX_FRAMES_IN_FLIGHT);
+    delete this->pipeline; this->pipeline = nullptr;
+}
+void Camera::zero_copy(bool enabled) {
+    // takes effect once prepare_rendering allocates the pixel buffer - after clear_rendering if already prepared
+    this->zero_copy_ = enabled;
+}
+void Camera::reset_accumulation(void) { this->n_accumulated = 0; }
+void Camera::threads(unsigned int n_threads) {
+    // stop worker pool - the next cpu frame starts a new one
+    this->n_threads_ = max(n_threads, 1u);
+    delete this->scheduler; this->scheduler = nullptr;
+    // cpu band renders with the same number of threads
+    if (this->bands != nullptr) {
+        for (Camera* band : *this->bands) { if (!band->openCL_assigned) band->threads(n_threads); }
+    }
+}
+
+/*** getters ***/
+unsigned int Camera::threads(void) const { return max(this->n_threads_, 1u); }
 
 /*** render ***/
 
-Vec3f Camera::get_color(pair<Vec3f, Vec3f>* ray, unsigned int r_depth) const {
-    // break recusion
-    if (r_depth >= MAX_RECURSION_DEPTH) { return Vec3f(1.0f, 1.0f, 1.0f); }
-    // cast ray to scene
-    float dist; Geometry* geo;
-    // no intersection
-    if (this->scene->cast(ray->first, ray->second, &geo, &dist)) {
-        // get point of interest
-        Vec3f p = ray->first + ray->second * (dist - EPS);
-        // get material and normal
-        Material* material = this->scene->get_material(geo->material());
-        Vec3f normal = geo->normal(p);
-        // get scatter ray
-        pair<Vec3f, Vec3f> scattered;
-        if (material->scatter(p, ray->second, normal, &scattered)) {
-            // scatter and light color
-            Vec3f scatter_color = this->get_color(&scattered, r_depth + 1);
-            Vec3f light_color = this->scene->light_color(p, ray->second, normal, material);
-            // get attenuation and compute color
-            Vec3f attenuation = material->attenuation(p, ray->second, normal);
-            Vec3f color = attenuation * light_color * scatter_color;
-            // return final color
-            return color.clamp(0, 1);
-        } else return material->attenuation(p, ray->second, normal);
-    } else { 
-        // gradient background
-        float t = 0.5 * (1.0 - ray->second.normalize().z());
-        return Vec3f(1.0, 1.0, 1.0) * (1.0 - t) + Vec3f(0.5, 0.7, 1.0) * t; 
+Vec3f Camera::trace(PathState* path, bool hit, Geometry* geo, unsigned int index, float dist) const {
+    // scatter ray at most n times
+    for (unsigned int depth = 0; depth < MAX_RECURSION_DEPTH; depth++) {
+        // cast scattered ray - the first hit is given
+        float t = dist;
+        if (depth > 0) hit = this->scene->cast(path->origin, path->direction, &geo, &index, &t);
+        // only continue if scatters
+        if (!this->bounce(path, hit, geo, index, t)) break;
+    }
+    return path->color;
+}
+
+bool Camera::bounce(PathState* path, bool hit, Geometry* geo, unsigned int index, float dist) const {
+    // no intersection - gradient background ends the path
+    if (!hit) {
+        float t = 0.5 * (1.0 - path->direction.normalize().z());
+        path->color = path->color * (Vec3f(1.0, 1.0, 1.0) * (1.0 - t) + Vec3f(0.5, 0.7, 1.0) * t);
+        return false;
     }
+    // get point of interest
+    Vec3f p = path->origin + path->direction * (dist - EPS);
+    // get material and normal
+    Material* material = this->scene->get_material(geo->material());
+    Vec3f normal = geo->primitive_normal(index, p);
+    // get attenuation and light color and update color
+    Vec3f attenuation = material->attenuation(p, path->direction, normal);
+    Vec3f light_color = this->scene->light_color(p, path->direction, normal, material, this->light_samples_);
+    path->color = path->color * (light_color * attenuation).clamp(0, 1);
+    // continue with scattered ray
+    pair<Vec3f, Vec3f> scattered;
+    if (!material->scatter(p, path->direction, normal, &scattered)) return false;
+    path->origin = scattered.first; path->direction = scattered.second;
+    return true;
 }
 
-Vec3f Camera::get_pixel_color(unsigned int i, unsigned int j, unsigned int w, unsigned int h) const {
-    // initialize with ray throu middle of pixel
-    pair<Vec3f, Vec3f> ray = this->ray(i, j, w, h);
-    Vec3f color = get_color(&ray);
-    // antialiasing
-    for (int k = 0; k < this->n_samples - 1; k++) {
-        // get random offset of pixel center
-        float u = 2 * ((float)rand() / RAND_MAX) - 1;
-        float v = 2 * ((float)rand() / RAND_MAX) - 1;
-        // create ray throu random position in pixel
-        ray = this->ray(i + u, j + v, w, h);
-        // get color of ray
-        color = color + this->get_color(&ray);
+void Camera::get_packet_color(unsigned int i, unsigned int j, unsigned int n, unsigned int w, unsigned int h, int lanes, Vec3f* colors, float* sum_sq) const {
+    // each lane keeps its own random sequence so colors match tracing the pixels one by one
+    float lane_on[PACKET_SIZE];
+    for (unsigned int l = 0; l < PACKET_SIZE; l++) { lane_on[l] = (lanes >> l) & 1; }
+    Float8 active = Float8::load(lane_on) > Float8(0.0f);
+    RandomState states[PACKET_SIZE];
+    // inactive lanes repeat the last pixel
+    pair<Vec3f, Vec3f> rays[PACKET_SIZE];
+    Vec3f origins[PACKET_SIZE], dirs[PACKET_SIZE];
+    Geometry* geos[PACKET_SIZE]; unsigned int indices[PACKET_SIZE]; float dists[PACKET_SIZE];
+    for (unsigned int k = 0; k < this->n_samples; k++) {
+        // first sample goes throu middle of pixel, others throu random positions in pixel
+        for (unsigned int l = 0; l < PACKET_SIZE; l++) {
+            float u = 0, v = 0;
+            if ((lanes >> l) & 1) {
+                // one stream per pixel and sample so the image does not depend on the tile schedule
+                seed_random(this->seed_, j * w + i + l, this->n_accumulated * this->n_samples + k);
+                if (k > 0) {
+                    u = 2 * randf() - 1;
+                    v = 2 * randf() - 1;
+                }
+                states[l] = random_state();
+            }
+            rays[l] = this->ray(i + min(l, n - 1) + u, j + v, w, h);
+            origins[l] = rays[l].first; dirs[l] = rays[l].second;
+        }
+        // cast primary rays together
+        Float8 dist;
+        int hits = this->scene->cast_packet(Vec3f8::gather(origins), Vec3f8::gather(dirs), active, geos, indices, &dist).bits();
+        dist.store(dists);
+        // shade each lane on its own
+        for (unsigned int l = 0; l < n; l++) {
+            if (!((lanes >> l) & 1)) continue;
+            random_state(states[l]);
+            PathState path = { rays[l].first, rays[l].second, Vec3f(1.0f, 1.0f, 1.0f) };
+            Vec3f c = this->trace(&path, (hits >> l) & 1, geos[l], indices[l], dists[l]);
+            colors[l] = (k == 0)? c : colors[l] + c;
+            // second moment of luminance for adaptive sampling
+            float y = (c.x() + c.y() + c.z()) / 3;
+            sum_sq[l] = (k == 0)? y * y : sum_sq[l] + y * y;
+        }
     }
-    // return average color
-    return color * (1.0 / this->n_samples);
+    // return average colors
+    for (unsigned int l = 0; l < n; l++) { colors[l] = colors[l] * (1.0 / this->n_samples); }
+}
+
+bool Camera::pixel_converged(const float* sum, const PixelStats& stats) const {
+    // same test as camera_pixel_converged of the kernel
+    if ((this->adaptive_max_samples_ > 0) && (stats.spp >= this->adaptive_max_samples_)) return true;
+    if (stats.spp < this->adaptive_min_samples_) return false;
+    // mean luminance over all samples - every frame took the same number of samples
+    float n = stats.spp, frames = stats.spp / this->n_samples;
+    float mean = (sum[0] + sum[1] + sum[2]) / (3 * frames);
+    float var = max((stats.sum_sq / n - mean * mean) * n / (n - 1), 0.0f);
+    // standard error after gamma correction - the square root scales errors by 1 / (2 sqrt(mean))
+    return sqrtf(var / n) <= 2 * this->adaptive_threshold_ * sqrtf(mean);
 }
 
 pair<Vec3f, Vec3f> Camera::ray(float i, float j, unsigned int w, unsigned int h) const {
@@ -138,33 +404,68 @@ pair<Vec3f, Vec3f> Camera::ray(float i, float j, unsigned int w, unsigned int h)
     return make_pair(this->pos_, ray_dir.normalize());
 }
 
-void Camera::render_cpu(void* pixels, unsigned int w, unsigned int h) const {
-    // render each pixel
-    for (int x = 0; x < w; x++) {
-        for (int y = 0; y < h; y++) {
-            // get color of pixel
-            Vec3f c = this->get_pixel_color(x, y, w, h);
-            // get values to override in pixel array
-            int i = y * w + x;
-            Uint8* base = ((Uint8 *)pixels) + (4 * i);
-            // apply color to pixel - apply gamma correction on pixels
-            base[0] = int(sqrt(c.x()) * 255);
-            base[1] = int(sqrt(c.y()) * 255);
-            base[2] = int(sqrt(c.z()) * 255);
-            base[3] = 255;
-       }
-    }
+void Camera::render_cpu(void* pixels, unsigned int w, unsigned int h, unsigned int y0, unsigned int y1) {
+    // allocate accumulation buffers on first frame of this size
+    if (this->accum == nullptr) { this->accum = new float[3 * w * h]; delete[] this->stats; this->stats = new PixelStats[w * h]; }
+    bool adaptive = (this->adaptive_threshold_ > 0) && (this->n_accumulated > 0);
+    // start workers on first cpu frame - opencl cameras and bands never need them
+    if (this->scheduler == nullptr) this->scheduler = new TileScheduler(this->n_threads_);
+    // render tiles in parallel - pixels are written in place so there is nothing to read back
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    this->scheduler->run(w, y0, y1, [&](const Tile& tile) {
+        // workers read the snapshots pinned for the frame
+        RendererReads reads;
+        // render rows of tile in packets of neighbouring pixels
+        Vec3f colors[PACKET_SIZE]; float sum_sq[PACKET_SIZE]; int lanes = 0;
+        for (unsigned int y = tile.y0; y < tile.y1; y++) {
+            for (unsigned int x = tile.x0; x < tile.x1; x++) {
+                int i = y * w + x;
+                // get colors of next packet - converged pixels of adaptive sampling take no samples
+                unsigned int l = (x - tile.x0) % PACKET_SIZE;
+                if (l == 0) {
+                    unsigned int n = min((unsigned int)PACKET_SIZE, tile.x1 - x);
+                    lanes = 0;
+                    for (unsigned int k = 0; k < n; k++) { if (!adaptive || !this->pixel_converged(this->accum + 3 * (i + k), this->stats[i + k])) lanes |= 1 << k; }
+                    if (lanes != 0) this->get_packet_color(x, y, n, w, h, lanes, colors, sum_sq);
+                }
+                // accumulate color and sample statistics - the first frame overrides old values
+                float* sum = this->accum + (3 * i);
+                PixelStats& stats = this->stats[i];
+                if ((lanes >> l) & 1) {
+                    Vec3f c = colors[l];
+                    if (this->n_accumulated == 0) { sum[0] = c.x(); sum[1] = c.y(); sum[2] = c.z(); stats.spp = this->n_samples; stats.sum_sq = sum_sq[l]; }
+                    else { sum[0] += c.x(); sum[1] += c.y(); sum[2] += c.z(); stats.spp += this->n_samples; stats.sum_sq += sum_sq[l]; }
+                }
+                // frames are averaged with equal weights
+                float scale = 1.0f / (stats.spp / this->n_samples);
+                // get values to override in pixel array
+                unsigned char* base = ((unsigned char*)pixels) + (4 * i);
+                // apply average color to pixel - apply gamma correction on pixels
+                base[0] = int(sqrt(sum[0] * scale) * 255);
+                base[1] = int(sqrt(sum[1] * scale) * 255);
+                base[2] = int(sqrt(sum[2] * scale) * 255);
+                base[3] = 255;
+            }
+        }
+    });
+    this->timings_.trace = seconds_since(start);
 }
 
 void Camera::prepare_rendering(unsigned int w, unsigned int h) {
+    // prepare cameras of all bands
+    if (this->bands != nullptr) {
+        for (Camera* band : *this->bands) { band->prepare_rendering(w, h); }
+    }
     if (this->openCL_assigned) {
         // prepare opencl only if not yet initialized
         if (this->kern == nullptr) {
-            // get kernel
+            // get kernel of program fitting the scene
+            this->select_program();
             this->kern = new Kernel(*this->program, "camera_get_pixel_color");
-            // create pixel buffer and set kernel argument
-            this->pixel_buf = new Buffer(*this->context, CL_MEM_WRITE_ONLY, h * w * 4);
-            this->kern->setArg(0, *this->pixel_buf);
+            // create pixel buffer - kernel arguments are set per frame as the kernel is replaced with the program
+            // on devices sharing memory with the host a host allocated buffer can be mapped without copying
+            this->pixel_buf = new Buffer(*this->context, CL_MEM_WRITE_ONLY | (this->zero_copy_? CL_MEM_ALLOC_HOST_PTR : 0), h * w * 4);
+            this->zero_copy_active = this->zero_copy_;
             
             // prepare globals
             this->globals_buf = new Buffer(*this->context, CL_MEM_READ_WRITE, h * w * 8);
@@ -173,59 +474,131 @@ void Camera::prepare_rendering(unsigned int w, unsigned int h) {
             // run kernel
             this->queue->enqueueNDRangeKernel(prepare_kern, cl::NullRange, cl::NDRange(h, w));
             this->queue->finish();
-            // set kernel argument
-            this->kern->setArg(33, *this->globals_buf);
+
+            // create accumulation buffer
+            this->accum_buf = new Buffer(*this->context, CL_MEM_READ_WRITE, h * w * 3 * sizeof(float));
+            this->stats_buf = new Buffer(*this->context, CL_MEM_READ_WRITE, h * w * sizeof(PixelStats));
+
+            // create persistent scene buffers - filled on first render
+            this->geometry_buf = new CompressorBuffer(this->context, this->queue, this->scene->get_geometry_compressor());
+            this->material_buf = new CompressorBuffer(this->context, this->queue, this->scene->get_material_compressor());
+            this->light_buf = new CompressorBuffer(this->context, this->queue, this->scene->get_light_compressor());
+            this->bvh_nodes_buf = new VectorBuffer(this->context, this->queue);
+            this->bvh_prims_buf = new VectorBuffer(this->context, this->queue);
+            this->bvh_spheres_buf = new VectorBuffer(this->context, this->queue);
+            this->mesh_vertices_buf = new VectorBuffer(this->context, this->queue);
+            this->mesh_indices_buf = new VectorBuffer(this->context, this->queue);
+            this->light_alias_buf = new VectorBuffer(this->context, this->queue);
         }
     }
 }
 
 void Camera::clear_rendering(void) {
+    // clear cameras of all bands
+    if (this->bands != nullptr) {
+        for (Camera* band : *this->bands) { band->clear_rendering(); }
+    }
     // clear only if previously initialized
     if (this->kern != nullptr) {
         // clear kernel and buffers
         delete this->kern;
+        this->unmap_pixels();
         delete this->pixel_buf;
+        this->zero_copy_active = false;
         delete this->globals_buf;
+        delete this->accum_buf;
+        delete this->stats_buf;
+        // clear scene buffers
+        delete this->geometry_buf;
+        delete this->material_buf;
+        delete this->light_buf;
+        delete this->bvh_nodes_buf;
+        delete this->bvh_prims_buf;
+        delete this->bvh_spheres_buf;
+        delete this->mesh_vertices_buf;
+        delete this->mesh_indices_buf;
+        delete this->light_alias_buf;
+        // clear wavefront pipeline and frames in flight
+        delete this->wf; this->wf = nullptr;
+        delete this->pipeline; this->pipeline = nullptr;
+        this->kern = nullptr;
+    }
+}
+
+bool Camera::sync_scene(void) {
+    // upload changed geometries, materials and lights
+    bool uploaded = this->geometry_buf->sync();
+    uploaded |= this->material_buf->sync();
+    uploaded |= this->light_buf->sync();
+    // upload bvh after rebuild or refit
+    const BVH* bvh = this->scene->get_bvh();
+    uploaded |= this->bvh_nodes_buf->sync(bvh->nodes()->data(), bvh->nodes()->size() * sizeof(BVHNode), bvh->version());
+    uploaded |= this->bvh_prims_buf->sync(bvh->prims()->data(), bvh->prims()->size() * sizeof(BVHPrimitive), bvh->version());
+    uploaded |= this->bvh_spheres_buf->sync(bvh->spheres()->data()->data(), bvh->spheres()->data()->size() * sizeof(float), bvh->version());
+    // upload meshes after new ones were added
+    const MeshBuffer* mesh = this->scene->get_mesh_buffer();
+    uploaded |= this->mesh_vertices_buf->sync(mesh->vertices()->data(), mesh->vertices()->size() * sizeof(float), mesh->version());
+    uploaded |= this->mesh_indices_buf->sync(mesh->indices()->data(), mesh->indices()->size() * sizeof(unsigned int), mesh->version());
+    // upload alias table after lights changed
+    const LightSampler* sampler = this->scene->get_light_sampler();
+    uploaded |= this->light_alias_buf->sync(sampler->entries()->data(), sampler->entries()->size() * sizeof(LightAlias), sampler->version());
+    return uploaded;
+}
+
+void Camera::set_scene_args(Kernel& kernel, unsigned int first_arg, unsigned int first_accel_arg) const {
+    // geometries, materials and lights each take six arguments
+    const MemCompressor* compressors[3] = { this->scene->get_geometry_compressor(), this->scene->get_material_compressor(), this->scene->get_light_compressor() };
+    const CompressorBuffer* buffers[3] = { this->geometry_buf, this->material_buf, this->light_buf };
+    for (unsigned int k = 0; k < 3; k++) {
+        unsigned int arg = first_arg + 6 * k;
+        // set buffers and sizes
+        kernel.setArg(arg + 0, buffers[k]->data());
+        kernel.setArg(arg + 1, buffers[k]->instance_table());
+        kernel.setArg(arg + 2, compressors[k]->n_instances());
+        kernel.setArg(arg + 3, (unsigned int)(compressors[k]->filled() * sizeof(float)));
+        // allocate local memory - data read from global memory and empty containers only need a placeholder
+        size_t data_bytes = this->local_staged[k]? compressors[k]->filled() * sizeof(float) : 0;
+        size_t table_bytes = this->local_staged[k]? 2 * compressors[k]->n_instances() * sizeof(unsigned int) : 0;
+        kernel.setArg(arg + 4, max(data_bytes, sizeof(float)), NULL);
+        kernel.setArg(arg + 5, max(table_bytes, sizeof(unsigned int)), NULL);
     }
+    // bvh
+    const BVH* bvh = this->scene->get_bvh();
+    kernel.setArg(first_accel_arg + 0, this->bvh_nodes_buf->buffer());
+    kernel.setArg(first_accel_arg + 1, this->bvh_prims_buf->buffer());
+    kernel.setArg(first_accel_arg + 2, (unsigned int)bvh->nodes()->size());
+    kernel.setArg(first_accel_arg + 3, bvh->n_unbounded());
+    // meshes
+    kernel.setArg(first_accel_arg + 4, this->mesh_vertices_buf->buffer());
+    kernel.setArg(first_accel_arg + 5, this->mesh_indices_buf->buffer());
+    // spheres of bvh primitives in structure-of-arrays layout
+    kernel.setArg(first_accel_arg + 6, this->bvh_spheres_buf->buffer());
+    kernel.setArg(first_accel_arg + 7, bvh->spheres()->stride());
+    // top levels of bvh copied to local memory
+    unsigned int n_nodes = min(this->n_local_nodes, (unsigned int)bvh->nodes()->size());
+    kernel.setArg(first_accel_arg + 8, max(n_nodes, 1u) * sizeof(BVHNode), NULL);
+    kernel.setArg(first_accel_arg + 9, n_nodes);
+    // alias table to pick lights by power
+    kernel.setArg(first_accel_arg + 10, this->light_alias_buf->buffer());
+}
+
+void Camera::select_work_group(unsigned int w, unsigned int y0, unsigned int y1) {
+    // tuning launches overwrite the accumulated colors - only tune on the first frame of an accumulation
+    if ((this->group_rows > 0) || (this->n_accumulated > 0) || (y1 <= y0)) return;
+    WorkGroup best = tune_work_group(*this->device, *this->kern, this->program_options, [&](const WorkGroup& g) {
+        this->queue->enqueueNDRangeKernel(*this->kern, cl::NDRange(y0, 0), cl::NDRange(round_up(y1 - y0, g.rows), round_up(w, g.cols)), cl::NDRange(g.rows, g.cols));
+        this->queue->finish();
+    });
+    this->group_rows = best.rows; this->group_cols = best.cols;
 }
 
-void Camera::render_gpu(void* pixels, unsigned int w, unsigned int h) const {
-
-    // update geometry buffers
-    cl::Buffer geometry_buf(*this->context, CL_MEM_COPY_HOST_PTR | CL_MEM_READ_ONLY, this->scene->get_geometry_compressor()->filled() * sizeof(float), this->scene->get_geometry_compressor()->data());
-    cl::Buffer geometry_ids(*this->context, CL_MEM_COPY_HOST_PTR | CL_MEM_READ_ONLY, this->scene->get_geometry_compressor()->n_instances() * sizeof(unsigned int), this->scene->get_geometry_compressor()->get_type_ids()->data());
-    // set kernel arguments
-    this->kern->setArg(1, geometry_buf);
-    this->kern->setArg(2, geometry_ids);
-    this->kern->setArg(3, this->scene->get_geometry_compressor()->n_instances());
-    this->kern->setArg(4, this->scene->get_geometry_compressor()->filled() * sizeof(float));
-    // allocate local memory
-    this->kern->setArg(5, this->scene->get_geometry_compressor()->filled() * sizeof(float), NULL);
-    this->kern->setArg(6, this->scene->get_geometry_compressor()->n_instances() * sizeof(unsigned int), NULL);
-
-    // update material buffers
-    cl::Buffer material_buf(*this->context, CL_MEM_COPY_HOST_PTR | CL_MEM_READ_ONLY, this->scene->get_material_compressor()->filled() * sizeof(float), this->scene->get_material_compressor()->data());
-    cl::Buffer material_ids(*this->context, CL_MEM_COPY_HOST_PTR | CL_MEM_READ_ONLY, this->scene->get_material_compressor()->n_instances() * sizeof(unsigned int), this->scene->get_material_compressor()->get_type_ids()->data());
-    // set kernel arguments
-    this->kern->setArg(7, material_buf);
-    this->kern->setArg(8, material_ids);
-    this->kern->setArg(9, this->scene->get_material_compressor()->n_instances());
-    this->kern->setArg(10, this->scene->get_material_compressor()->filled() * sizeof(float));
-    // allocate local memory
-    this->kern->setArg(11, this->scene->get_material_compressor()->filled() * sizeof(float), NULL);
-    this->kern->setArg(12, this->scene->get_material_compressor()->n_instances() * sizeof(unsigned int), NULL);
-
-    // update light buffers
-    cl::Buffer light_buf(*this->context, CL_MEM_COPY_HOST_PTR | CL_MEM_READ_ONLY, this->scene->get_light_compressor()->filled() * sizeof(float), this->scene->get_light_compressor()->data());
-    cl::Buffer light_ids(*this->context, CL_MEM_COPY_HOST_PTR | CL_MEM_READ_ONLY, this->scene->get_light_compressor()->n_instances() * sizeof(unsigned int), this->scene->get_light_compressor()->get_type_ids()->data());
-    // set kernel arguments
-    this->kern->setArg(13, light_buf);
-    this->kern->setArg(14, light_ids);
-    this->kern->setArg(15, this->scene->get_light_compressor()->n_instances());
-    this->kern->setArg(16, this->scene->get_light_compressor()->filled() * sizeof(float));
-    // allocate local memory
-    this->kern->setArg(17, this->scene->get_light_compressor()->filled() * sizeof(float), NULL);
-    this->kern->setArg(18, this->scene->get_light_compressor()->n_instances() * sizeof(unsigned int), NULL);
+void Camera::render_megakernel(unsigned int w, unsigned int h, unsigned int y0, unsigned int y1) {
+    // set pixel, globals and accumulation buffers
+    this->kern->setArg(0, *this->pixel_buf);
+    this->kern->setArg(33, *this->globals_buf);
+    this->kern->setArg(45, *this->accum_buf);
+    // set scene arguments
+    this->set_scene_args(*this->kern, 1, 34);
 
     // set camera position
     Vec3f temp = this->scene->get_active_camera()->position();
@@ -244,24 +617,349 @@ void Camera::render_gpu(void* pixels, unsigned int w, unsigned int h) const {
     this->kern->setArg(31, this->scene->ambient().y());
     this->kern->setArg(32, this->scene->ambient().z());
 
-    // render on opencl device
-    this->queue->enqueueNDRangeKernel(*this->kern, cl::NullRange, cl::NDRange(h, w));
-    this->queue->enqueueReadBuffer(*this->pixel_buf, CL_TRUE, 0, h * w * 4, pixels);
-    this->queue->finish();
+    // number of frames already accumulated and seed of random numbers
+    this->kern->setArg(46, this->n_accumulated);
+    this->kern->setArg(47, this->seed_);
+    // size of whole image - the range covers the rows of this band only
+    this->kern->setArg(48, h);
+    this->kern->setArg(49, w);
+    this->kern->setArg(50, y1);
+    // adaptive sampling and sample statistics of each pixel
+    this->kern->setArg(51, this->adaptive_threshold_);
+    this->kern->setArg(52, this->adaptive_min_samples_);
+    this->kern->setArg(53, this->adaptive_max_samples_);
+    this->kern->setArg(54, *this->stats_buf);
+
+    // render on opencl device - the range is padded to whole work-groups once their shape is known
+    this->select_work_group(w, y0, y1);
+    if (y1 <= y0) return;
+    if (this->group_rows > 0) this->queue->enqueueNDRangeKernel(*this->kern, cl::NDRange(y0, 0), cl::NDRange(round_up(y1 - y0, this->group_rows), round_up(w, this->group_cols)), cl::NDRange(this->group_rows, this->group_cols));
+    else this->queue->enqueueNDRangeKernel(*this->kern, cl::NDRange(y0, 0), cl::NDRange(y1 - y0, w));
+}
+
+void Camera::render_wavefront(unsigned int w, unsigned int h) {
+    unsigned int n = w * h;
+    // create pipeline on first use or for new image size
+    if ((this->wf != nullptr) && (this->wf->n != n)) { delete this->wf; this->wf = nullptr; }
+    if (this->wf == nullptr) this->wf = new Wavefront(*this->program, *this->context, *this->queue, n);
+    Wavefront* wf = this->wf;
+
+    // ray generation
+    wf->generate.setArg(0, wf->paths);
+    wf->generate.setArg(1, wf->queues[0]);
+    wf->generate.setArg(2, wf->sample_sum);
+    wf->generate.setArg(3, *this->globals_buf);
+    wf->generate.setArg(4, w); wf->generate.setArg(5, h);
+    Vec3f temp = this->scene->get_active_camera()->position();
+    wf->generate.setArg(6, temp.x()); wf->generate.setArg(7, temp.y()); wf->generate.setArg(8, temp.z());
+    temp = this->scene->get_active_camera()->direction();
+    wf->generate.setArg(9, temp.x()); wf->generate.setArg(10, temp.y()); wf->generate.setArg(11, temp.z());
+    temp = this->scene->get_active_camera()->up();
+    wf->generate.setArg(12, temp.x()); wf->generate.setArg(13, temp.y()); wf->generate.setArg(14, temp.z());
+    wf->generate.setArg(15, this->scene->get_active_camera()->FOV());
+    wf->generate.setArg(17, this->seed_);
+    wf->generate.setArg(18, this->n_accumulated * this->n_samples);
+    // intersection
+    this->set_scene_args(wf->intersect, 0, 18);
+    wf->intersect.setArg(29, wf->paths);
+    wf->intersect.setArg(31, wf->material_queues);
+    wf->intersect.setArg(32, n);
+    wf->intersect.setArg(33, wf->counters);
+    wf->intersect.setArg(34, wf->sample_sum);
+    wf->intersect.setArg(35, *this->globals_buf);
+    // shading per material type
+    for (unsigned int t = 0; t < MATERIAL_N_TYPES; t++) {
+        this->set_scene_args(wf->shade[t], 0, 18);
+        wf->shade[t].setArg(29, wf->paths);
+        wf->shade[t].setArg(30, wf->material_queues);
+        wf->shade[t].setArg(31, n);
+        wf->shade[t].setArg(32, wf->shadow_queue);
+        wf->shade[t].setArg(34, *this->globals_buf);
+    }
+    // shadow rays
+    this->set_scene_args(wf->shadow, 0, 18);
+    wf->shadow.setArg(29, wf->paths);
+    wf->shadow.setArg(30, wf->shadow_queue);
+    wf->shadow.setArg(32, wf->counters);
+    wf->shadow.setArg(33, wf->sample_sum);
+    wf->shadow.setArg(34, this->scene->ambient().x());
+    wf->shadow.setArg(35, this->scene->ambient().y());
+    wf->shadow.setArg(36, this->scene->ambient().z());
+    wf->shadow.setArg(37, *this->globals_buf);
+
+    // trace all paths of one antialiasing sample at a time
+    unsigned int zeros[1 + MATERIAL_N_TYPES] = {};
+    for (unsigned int s = 0; s < this->n_samples; s++) {
+        // start one path per pixel
+        wf->generate.setArg(16, s);
+        this->queue->enqueueNDRangeKernel(wf->generate, cl::NullRange, cl::NDRange(n));
+        // bounce until all paths ended
+        unsigned int n_active = n, current = 0;
+        for (unsigned int bounce = 0; (bounce < MAX_RECURSION_DEPTH) && (n_active > 0); bounce++) {
+            // intersect active paths and sort hits by material type
+            this->queue->enqueueWriteBuffer(wf->counters, CL_FALSE, 0, sizeof(zeros), zeros);
+            wf->intersect.setArg(30, wf->queues[current]);
+            this->queue->enqueueNDRangeKernel(wf->intersect, cl::NullRange, cl::NDRange(n_active));
+            unsigned int counts[1 + MATERIAL_N_TYPES];
+            this->queue->enqueueReadBuffer(wf->counters, CL_TRUE, 0, sizeof(counts), counts);
+            // shade each material type on its own - types stay contiguous in the shadow queue
+            unsigned int n_shaded = 0;
+            for (unsigned int t = 0; t < MATERIAL_N_TYPES; t++) {
+                if (counts[1 + t] == 0) continue;
+                wf->shade[t].setArg(33, n_shaded);
+                this->queue->enqueueNDRangeKernel(wf->shade[t], cl::NullRange, cl::NDRange(counts[1 + t]));
+                n_shaded += counts[1 + t];
+            }
+            if (n_shaded == 0) break;
+            // cast shadow rays and collect paths for the next bounce
+            wf->shadow.setArg(31, wf->queues[1 - current]);
+            this->queue->enqueueNDRangeKernel(wf->shadow, cl::NullRange, cl::NDRange(n_shaded));
+            this->queue->enqueueReadBuffer(wf->counters, CL_TRUE, 0, sizeof(unsigned int), &n_active);
+            current = 1 - current;
+        }
+    }
+
+    // average samples and write pixels
+    wf->finish.setArg(0, *this->pixel_buf);
+    wf->finish.setArg(1, wf->sample_sum);
+    wf->finish.setArg(2, this->n_samples);
+    wf->finish.setArg(3, *this->accum_buf);
+    wf->finish.setArg(4, this->n_accumulated);
+    wf->finish.setArg(5, *this->stats_buf);
+    this->queue->enqueueNDRangeKernel(wf->finish, cl::NullRange, cl::NDRange(n));
+}
+
+void Camera::read_pipelined(void* pixels, unsigned int w, unsigned int h) {
+    // create pipeline on first use or for new image size
+    size_t bytes = (size_t)w * h * 4;
+    if ((this->pipeline != nullptr) && (this->pipeline->bytes != bytes)) { delete this->pipeline; this->pipeline = nullptr; }
+    if (this->pipeline == nullptr) this->pipeline = new FramePipeline(*this->context, *this->queue, this->frames_in_flight_, bytes);
+    FramePipeline* p = this->pipeline;
+    // read this frame into its slot without blocking - the frame last read into that slot was already presented
+    unsigned int k = p->n_frames++;
+    this->queue->enqueueReadBuffer(*this->pixel_buf, CL_FALSE, 0, bytes, p->host[k % p->n_slots], nullptr, &p->ready[k % p->n_slots]);
+    this->queue->flush();
+    // present the frame read n_slots - 1 frames ago - the first frame is repeated until the pipeline is full
+    unsigned int presented = (k + 1 >= p->n_slots)? (k + 1 - p->n_slots) : 0;
+    p->ready[presented % p->n_slots].wait();
+    memcpy(pixels, p->host[presented % p->n_slots], bytes);
+}
+
+void Camera::render_gpu(void* pixels, unsigned int w, unsigned int h, unsigned int y0, unsigned int y1) {
+    // frames in flight, zero copy and the wavefront pipeline work on whole frames only
+    bool whole = (y0 == 0) && (y1 == h);
+    // wavefront paths all take the same number of samples
+    bool wavefront = this->wavefront_ && whole && (this->adaptive_threshold_ <= 0);
+    bool pipelined = (this->frames_in_flight_ > 1) && !this->zero_copy_active && whole;
+    // the kernel must not write pixels the host still reads
+    this->unmap_pixels();
+    // switch program if types were added to the scene or the sample count changed
+    this->select_program();
+    // upload changes of scene - uploads read snapshots that may be freed once this frame returns
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    bool uploaded = this->sync_scene();
+    if (uploaded || !pipelined) this->queue->finish();
+    this->timings_.upload = seconds_since(start);
+    // render with selected pipeline
+    start = chrono::steady_clock::now();
+    if (wavefront) this->render_wavefront(w, h);
+    else this->render_megakernel(w, h, y0, y1);
+    if (!pipelined) this->queue->finish();
+    this->timings_.trace = seconds_since(start);
+    // read pixels
+    start = chrono::steady_clock::now();
+    if (this->zero_copy_active && whole) {
+        // map pixels in place - plain render calls copy and release them at once
+        this->mapped_pixels = this->queue->enqueueMapBuffer(*this->pixel_buf, CL_TRUE, CL_MAP_READ, 0, h * w * 4);
+        if (pixels != nullptr) { memcpy(pixels, this->mapped_pixels, h * w * 4); this->unmap_pixels(); }
+    }
+    else if (pipelined) this->read_pipelined(pixels, w, h);
+    else if (y1 > y0) this->queue->enqueueReadBuffer(*this->pixel_buf, CL_TRUE, (size_t)y0 * w * 4, (size_t)(y1 - y0) * w * 4, ((char*)pixels) + (size_t)y0 * w * 4);
+    this->timings_.readback = seconds_since(start);
+}
+
+void Camera::read_accum(float* dst, size_t first, size_t count) {
+    // copy accumulated colors of a range of pixels to the host
+    if (this->openCL_assigned) this->queue->enqueueReadBuffer(*this->accum_buf, CL_TRUE, first * sizeof(float), count * sizeof(float), dst);
+    else memcpy(dst, this->accum + first, count * sizeof(float));
+}
+
+void Camera::write_accum(const float* src, size_t first, size_t count) {
+    // replace accumulated colors of a range of pixels
+    if (this->openCL_assigned) this->queue->enqueueWriteBuffer(*this->accum_buf, CL_TRUE, first * sizeof(float), count * sizeof(float), src);
+    else memcpy(this->accum + first, src, count * sizeof(float));
+}
+
+void Camera::read_stats(PixelStats* dst, size_t first, size_t count) {
+    // copy sample statistics of a range of pixels to the host
+    if (this->openCL_assigned) this->queue->enqueueReadBuffer(*this->stats_buf, CL_TRUE, first * sizeof(PixelStats), count * sizeof(PixelStats), dst);
+    else memcpy(dst, this->stats + first, count * sizeof(PixelStats));
+}
+
+void Camera::write_stats(const PixelStats* src, size_t first, size_t count) {
+    // replace sample statistics of a range of pixels
+    if (this->openCL_assigned) this->queue->enqueueWriteBuffer(*this->stats_buf, CL_TRUE, first * sizeof(PixelStats), count * sizeof(PixelStats), src);
+    else memcpy(this->stats + first, src, count * sizeof(PixelStats));
+}
+
+void Camera::split_bands(unsigned int w, unsigned int h) {
+    std::vector<unsigned int>& rows = *this->band_rows;
+    std::vector<double>& speed = *this->band_speed;
+    unsigned int n = this->bands->size();
+    // first frame of this size splits rows evenly - nothing accumulated yet
+    if (rows[n] != h) {
+        for (unsigned int k = 0; k <= n; k++) { rows[k] = (unsigned int)((unsigned long)h * k / n); }
+        fill(speed.begin(), speed.end(), 0.0);
+        return;
+    }
+    // every band needs rows to measure its speed
+    if (h < n) return;
+    // keep split while the predicted times of all bands are within ten percent of each other
+    double t_min = INFINITY, t_max = 0, total = 0;
+    for (unsigned int k = 0; k < n; k++) {
+        if (speed[k] <= 0) return;
+        double t = (rows[k + 1] - rows[k]) / speed[k];
+        t_min = min(t_min, t); t_max = max(t_max, t);
+        total += speed[k];
+    }
+    if (t_max <= 1.1 * t_min) return;
+    // band heights proportional to speed - at least one row per band
+    std::vector<unsigned int> old_rows = rows;
+    double sum = 0;
+    for (unsigned int k = 1; k < n; k++) {
+        sum += speed[k - 1];
+        unsigned int y = (unsigned int)(h * sum / total + 0.5);
+        rows[k] = min(max(y, rows[k - 1] + 1), h - (n - k));
+    }
+    // rows that changed bands take their accumulated colors and sample statistics along
+    if (this->n_accumulated == 0) return;
+    std::vector<float> moved;
+    std::vector<PixelStats> moved_stats;
+    for (unsigned int a = 0; a < n; a++) {
+        for (unsigned int b = 0; b < n; b++) {
+            unsigned int y0 = max(old_rows[a], rows[b]), y1 = min(old_rows[a + 1], rows[b + 1]);
+            if ((a == b) || (y0 >= y1)) continue;
+            size_t first = (size_t)y0 * w * 3, count = (size_t)(y1 - y0) * w * 3;
+            moved.resize(count);
+            this->bands->at(a)->read_accum(moved.data(), first, count);
+            this->bands->at(b)->write_accum(moved.data(), first, count);
+            moved_stats.resize(count / 3);
+            this->bands->at(a)->read_stats(moved_stats.data(), first / 3, count / 3);
+            this->bands->at(b)->write_stats(moved_stats.data(), first / 3, count / 3);
+        }
+    }
+}
+
+void Camera::render_bands(void* pixels, unsigned int w, unsigned int h) {
+    // cameras of bands follow the view and settings of this camera
+    for (Camera* band : *this->bands) {
+        band->pos_ = this->pos_; band->dir_ = this->dir_; band->up_ = this->up_; band->left_ = this->left_;
+        band->FOV_ = this->FOV_; band->n_samples = this->n_samples; band->light_samples_ = this->light_samples_; band->seed_ = this->seed_;
+        band->adaptive_threshold_ = this->adaptive_threshold_;
+        band->adaptive_min_samples_ = this->adaptive_min_samples_; band->adaptive_max_samples_ = this->adaptive_max_samples_;
+        band->n_accumulated = this->n_accumulated;
+        // cpu band allocates a new accumulation buffer for a new image size
+        if (band->accum_size != w * h) { delete[] band->accum; band->accum = nullptr; band->accum_size = w * h; }
+    }
+    // rebalance rows by speed measured in the last frame
+    this->split_bands(w, h);
+    std::vector<unsigned int>& rows = *this->band_rows;
+    // render all bands at the same time - pixels of the bands do not overlap
+    std::vector<thread> workers;
+    for (unsigned int k = 0; k < this->bands->size(); k++) {
+        workers.emplace_back([this, pixels, w, h, k, &rows]{ RendererReads reads; this->bands->at(k)->render_rows(pixels, w, h, rows[k], rows[k + 1]); });
+    }
+    for (thread& t : workers) { t.join(); }
+    // measure speed of each band without uploads - averaged with earlier frames to smooth out noise
+    for (unsigned int k = 0; k < this->bands->size(); k++) {
+        const RenderTimings& t = this->bands->at(k)->timings_;
+        double time = t.trace + t.readback;
+        if ((rows[k + 1] == rows[k]) || (time <= 0)) continue;
+        double s = (rows[k + 1] - rows[k]) / time;
+        double& speed = this->band_speed->at(k);
+        speed = (speed > 0)? 0.5 * (speed + s) : s;
+        // phases of the slowest band
+        this->timings_.upload = max(this->timings_.upload, t.upload);
+        this->timings_.trace = max(this->timings_.trace, t.trace);
+        this->timings_.readback = max(this->timings_.readback, t.readback);
+    }
+}
+
+void Camera::render(void* pixels, unsigned int w, unsigned int h) {
+    // frame reads one version of the scene while other threads may edit it
+    RendererReads reads;
+    this->scene->pin();
+    // rebuild or refit bvh on changed geometries and light table on changed lights
+    this->timings_ = RenderTimings();
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    this->scene->get_bvh()->update();
+    this->scene->get_light_sampler()->update();
+    this->timings_.update = seconds_since(start);
+    // restart accumulation if the scene changed
+    if (this->scene->version() != this->accum_version) {
+        this->accum_version = this->scene->version();
+        this->reset_accumulation();
+    }
+    // restart accumulation with new buffer if the image size changed
+    if (this->accum_size != w * h) {
+        delete[] this->accum; this->accum = nullptr;
+        this->accum_size = w * h;
+        this->reset_accumulation();
+    }
+    // render bands on all devices or whole frame on one
+    if (this->bands != nullptr) { this->render_bands(pixels, w, h); }
+    else { this->render_rows(pixels, w, h, 0, h); }
+    // one more frame accumulated
+    this->n_accumulated++;
+    // writers may free the snapshots now - uploads from them finished within the frame
+    this->scene->unpin();
 }
 
-void Camera::render(void* pixels, unsigned int w, unsigned int h) const {
+void Camera::render_rows(void* pixels, unsigned int w, unsigned int h, unsigned int y0, unsigned int y1) {
     // render on gpu if assigned
-    if (this->openCL_assigned) { this->render_gpu(pixels, w, h); }
+    if (this->openCL_assigned) { this->render_gpu(pixels, w, h, y0, y1); }
     // render on cpu otherwise
-    else { this->render_cpu(pixels, w, h); }
+    else { this->render_cpu(pixels, w, h, y0, y1); }
+}
+
+void Camera::spp_map(std::vector<unsigned int>* counts) {
+    counts->assign(this->accum_size, 0);
+    if ((this->n_accumulated == 0) || (this->accum_size == 0)) return;
+    std::vector<PixelStats> all(this->accum_size);
+    // single device holds all rows
+    if (this->bands == nullptr) this->read_stats(all.data(), 0, this->accum_size);
+    // each band holds its rows
+    else {
+        unsigned int w = this->accum_size / this->band_rows->back();
+        for (unsigned int k = 0; k < this->bands->size(); k++) {
+            size_t first = (size_t)this->band_rows->at(k) * w, count = (size_t)(this->band_rows->at(k + 1) - this->band_rows->at(k)) * w;
+            if (count > 0) this->bands->at(k)->read_stats(all.data() + first, first, count);
+        }
+    }
+    for (unsigned int i = 0; i < this->accum_size; i++) { counts->at(i) = all[i].spp; }
 }
 
-void Camera::render_to_file(const char* fname, int width, int height, int dpi) {
-        // some values
+const void* Camera::render_mapped(unsigned int w, unsigned int h) {
+    // render without copying pixels to caller - other paths would write to the missing pixels
+    if (!this->zero_copy()) return nullptr;
+    this->render(nullptr, w, h);
+    return this->mapped_pixels;
+}
+
+void Camera::unmap_pixels(void) {
+    // hand pixel buffer back to device
+    if (this->mapped_pixels == nullptr) return;
+    this->queue->enqueueUnmapMemObject(*this->pixel_buf, this->mapped_pixels);
+    this->mapped_pixels = nullptr;
+}
+
+bool Camera::render_to_file(const char* fname, int width, int height, int dpi) {
+        // some values - rows of the file are padded to multiples of 4 bytes
         int k = width * height;
         int s = 4 * k;
-        int n_bytes = 54 + s;
+        int row_bytes = (3 * width + 3) / 4 * 4;
+        int image_bytes = row_bytes * height;
+        int n_bytes = 54 + image_bytes;
 
         // prepare rendering
         this->prepare_rendering(width, height);
@@ -269,14 +967,15 @@ void Camera::render_to_file(const char* fname, int width, int height, int dpi) {
         // log
         cout << "Rendering Image... "; cout.flush();
         // track time of rendering
-        time_t start = clock();
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
 
         // render image
-        char image[s];
+        std::vector<char> pixels(s);
+        char* image = pixels.data();
         this->render(image, width, height);
 
         // log time needed for rendering
-        cout << "Done (" << (clock() - start) / 1000.0 << "s)" << endl;
+        cout << "Done (" << seconds_since(start) << "s)" << endl;
 
         // clean after render
         this->clear_rendering();
@@ -304,34 +1003,41 @@ void Camera::render_to_file(const char* fname, int width, int height, int dpi) {
         info_header[10] = (unsigned char)(height>>16);
         info_header[11] = (unsigned char)(height>>24);
 
-        info_header[21] = (unsigned char)(s);
-        info_header[22] = (unsigned char)(s>>8);
-        info_header[23] = (unsigned char)(s>>16);
-        info_header[24] = (unsigned char)(s>>24);
-
-        info_header[25] = (unsigned char)(ppm);
-        info_header[26] = (unsigned char)(ppm>>8);
-        info_header[27] = (unsigned char)(ppm>>16);
-        info_header[28] = (unsigned char)(ppm>>24);
-
-        info_header[30] = (unsigned char)(3);
+        info_header[20] = (unsigned char)(image_bytes);
+        info_header[21] = (unsigned char)(image_bytes>>8);
+        info_header[22] = (unsigned char)(image_bytes>>16);
+        info_header[23] = (unsigned char)(image_bytes>>24);
+        // horizontal and vertical resolution
+        for (int o = 24; o <= 28; o += 4) {
+            info_header[o + 0] = (unsigned char)(ppm);
+            info_header[o + 1] = (unsigned char)(ppm>>8);
+            info_header[o + 2] = (unsigned char)(ppm>>16);
+            info_header[o + 3] = (unsigned char)(ppm>>24);
+        }
 
         // open file
         std::FILE* file; file = fopen(fname, "wb");
+        if (file == NULL) { cout << "Could not open file: " << fname << endl; return false; }
 
         // write headers to file
         fwrite(file_header, 1, 14, file);
         fwrite(info_header, 1, 40, file);
 
-        // write image - read bgr from rgba format
-        for (int i = k-1; i >= 0; i--) {
-            fwrite(image + i * 4 + 2, 1, 1, file);  // blue
-            fwrite(image + i * 4 + 1, 1, 1, file);  // green
-            fwrite(image + i * 4 + 0, 1, 1, file);  // red
+        // write image - bottom row first, bgr from rgba format and zero padding at the end of each row
+        std::vector<unsigned char> row(row_bytes, 0);
+        for (int y = height - 1; y >= 0; y--) {
+            for (int x = 0; x < width; x++) {
+                const char* p = image + 4 * (x + y * width);
+                row[3 * x + 0] = p[2];  // blue
+                row[3 * x + 1] = p[1];  // green
+                row[3 * x + 2] = p[0];  // red
+            }
+            fwrite(row.data(), 1, row_bytes, file);
         }
         // close file
         fclose(file);
 
         // log
         cout << "Saved image: " << fname << endl;
+        return true;
 }
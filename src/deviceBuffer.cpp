@@ -0,0 +1,101 @@
+// external
+#include "CL/cl2.hpp"
+// internal
+#include "deviceBuffer.hpp"
+// standard
+#include <algorithm>
+
+using namespace std;
+
+/*** Compressor Buffer ***/
+
+CompressorBuffer::CompressorBuffer(cl::Context* context, cl::CommandQueue* queue, const MemCompressor* compressor):
+    context(context), queue(queue), compressor(compressor), data_capacity(0), table_capacity(0), synced(false), version_synced(0), n_synced(0)
+{
+    // data grows with the memory of the compressor
+    this->data_capacity = this->compressor->size();
+    this->data_ = new cl::Buffer(*this->context, CL_MEM_READ_ONLY, this->data_capacity * sizeof(float));
+    // instance table grows with the number of instances - empty buffers are invalid
+    this->table_capacity = max(2 * this->compressor->n_instances(), 1u);
+    this->table_ = new cl::Buffer(*this->context, CL_MEM_READ_ONLY, this->table_capacity * sizeof(unsigned int));
+    // create vectors
+    this->table = new vector<unsigned int>();
+    this->ranges = new vector<pair<unsigned int, unsigned int>>();
+}
+
+CompressorBuffer::~CompressorBuffer(void) {
+    // delete buffers and vectors
+    delete this->data_;
+    delete this->table_;
+    delete this->table;
+    delete this->ranges;
+}
+
+bool CompressorBuffer::sync(void) {
+    // nothing changed since last sync
+    if (this->synced && (this->version_synced == this->compressor->version())) return false;
+    // memory of compressor grew - upload everything to a larger buffer
+    if (this->compressor->size() > this->data_capacity) {
+        this->data_capacity = this->compressor->size();
+        delete this->data_;
+        this->data_ = new cl::Buffer(*this->context, CL_MEM_READ_ONLY, this->data_capacity * sizeof(float));
+        this->synced = false;
+    }
+    // upload changed data - everything on first sync
+    this->ranges->clear();
+    this->compressor->changed_ranges(this->synced? this->version_synced : 0, this->ranges);
+    for (pair<unsigned int, unsigned int> r : *this->ranges)
+        this->queue->enqueueWriteBuffer(*this->data_, CL_FALSE, r.first * sizeof(float), r.second * sizeof(float), this->compressor->data() + r.first);
+    // type ids and offsets of instances never change so the table only needs an upload when instances were added
+    unsigned int n = this->compressor->n_instances();
+    if (n > this->n_synced) {
+        // grow geometrically
+        if (2 * n > this->table_capacity) {
+            this->table_capacity = max(2 * n, 2 * this->table_capacity);
+            delete this->table_;
+            this->table_ = new cl::Buffer(*this->context, CL_MEM_READ_ONLY, this->table_capacity * sizeof(unsigned int));
+        }
+        // offsets follow all type ids so the whole table moves with the number of instances
+        this->table->assign(this->compressor->get_type_ids()->begin(), this->compressor->get_type_ids()->end());
+        this->table->insert(this->table->end(), this->compressor->get_offsets()->begin(), this->compressor->get_offsets()->end());
+        this->queue->enqueueWriteBuffer(*this->table_, CL_FALSE, 0, this->table->size() * sizeof(unsigned int), this->table->data());
+    }
+    // update state
+    this->n_synced = n;
+    this->version_synced = this->compressor->version();
+    this->synced = true;
+    return true;
+}
+
+
+/*** Vector Buffer ***/
+
+VectorBuffer::VectorBuffer(cl::Context* context, cl::CommandQueue* queue):
+    context(context), queue(queue), buffer_(nullptr), capacity(0), synced(false), version_synced(0)
+{
+    // start with a small buffer - empty buffers are invalid
+    this->capacity = sizeof(float);
+    this->buffer_ = new cl::Buffer(*this->context, CL_MEM_READ_ONLY, this->capacity);
+}
+
+VectorBuffer::~VectorBuffer(void) {
+    // delete buffer
+    delete this->buffer_;
+}
+
+bool VectorBuffer::sync(const void* data, size_t bytes, unsigned int version) {
+    // nothing changed since last sync
+    if (this->synced && (this->version_synced == version)) return false;
+    // grow buffer geometrically
+    if (bytes > this->capacity) {
+        this->capacity = max(bytes, 2 * this->capacity);
+        delete this->buffer_;
+        this->buffer_ = new cl::Buffer(*this->context, CL_MEM_READ_ONLY, this->capacity);
+    }
+    // upload data
+    if (bytes > 0) this->queue->enqueueWriteBuffer(*this->buffer_, CL_FALSE, 0, bytes, data);
+    // update state
+    this->version_synced = version;
+    this->synced = true;
+    return true;
+}
@@ -0,0 +1,42 @@
+// external
+#include "CL/cl2.hpp"
+// internal
+#include "devices.hpp"
+// standard
+#include <vector>
+#include <iostream>
+#include <cstdlib>
+
+using namespace std;
+
+/*** device selection ***/
+
+bool select_device(const string& name, cl::Device* device) {
+    // list all platforms
+    vector<cl::Platform> platforms; cl::Platform::get(&platforms);
+    // first gpu of any platform
+    if (name == "gpu") {
+        vector<cl::Device> devices; gpu_devices(&devices);
+        if (!devices.empty()) { *device = devices[0]; return true; }
+        cout << "No OpenCL gpu found" << endl;
+        return false;
+    }
+    // explicit platform and device index
+    size_t sep = name.find(':');
+    if (sep == string::npos) { cout << "Unknown device " << name << endl; return false; }
+    unsigned int p = atoi(name.substr(0, sep).c_str()), d = atoi(name.substr(sep + 1).c_str());
+    if (p >= platforms.size()) { cout << "No OpenCL platform " << p << endl; return false; }
+    vector<cl::Device> devices; platforms[p].getDevices(CL_DEVICE_TYPE_ALL, &devices);
+    if (d >= devices.size()) { cout << "No OpenCL device " << d << " on platform " << p << endl; return false; }
+    *device = devices[d];
+    return true;
+}
+
+void gpu_devices(vector<cl::Device>* devices) {
+    // collect in platform order - platforms without gpus add nothing
+    vector<cl::Platform> platforms; cl::Platform::get(&platforms);
+    for (cl::Platform& p : platforms) {
+        vector<cl::Device> found; p.getDevices(CL_DEVICE_TYPE_GPU, &found);
+        devices->insert(devices->end(), found.begin(), found.end());
+    }
+}
@@ -6,7 +6,7 @@
 #include "scene.hpp"
 #include "camera.hpp"
 // standard
-#include <time.h>
+#include <chrono>
 #include <iostream>
 
 using namespace std;
@@ -73,8 +73,16 @@ void Engine::update(void) {
 }
 
 void Engine::render(void) {
-    // render scene on cpu
-    this->active_scene->get_active_camera()->render(
+    Camera* cam = this->active_scene->get_active_camera();
+    // hand mapped device pixels straight to the texture upload
+    if (cam->zero_copy()) {
+        const void* pixels = cam->render_mapped(this->window->get_width(), this->window->get_height());
+        this->window->display(pixels);
+        cam->unmap_pixels();
+        return;
+    }
+    // render scene into locked texture
+    cam->render(
         this->window->pixels(), this->window->get_width(), this->window->get_height()
     ); // display pixels
     this->window->display();
@@ -91,8 +99,8 @@ void Engine::run(void) {
 
     // mainloop
     while (this->running) {
-        // track time
-        time_t start = clock();
+        // track wall time - clock() sums up the cpu time of all render threads
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
 
         // handle events and update
         this->handle_events();
@@ -101,7 +109,7 @@ void Engine::run(void) {
         this->render();
 
         // log fps
-        cout << "FPS: " << 1000 / (float)(clock() - start) << "\r"; cout.flush();
+        cout << "FPS: " << 1 / chrono::duration<float>(chrono::steady_clock::now() - start).count() << "\r"; cout.flush();
     }
 
     // clear active cameras
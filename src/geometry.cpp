@@ -1,5 +1,92 @@
 #include "geometry.hpp"
 #include "math.h"
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <limits>
+#include <cstdlib>
+
+using namespace std;
+
+/* Helpers */
+
+// watertight ray-triangle intersection (Woop, Benthin, Wald 2013) - mirrors triangle_intersect in geometry.cl
+static bool triangle_intersect(const Vec3f A_, const Vec3f B_, const Vec3f C_, const Vec3f origin, const Vec3f dir, float* t) {
+    // permute axes so that the ray travels mostly along z
+    Vec3f d_abs(fabs(dir.x()), fabs(dir.y()), fabs(dir.z()));
+    unsigned int kz = (d_abs.x() > d_abs.y())? ((d_abs.x() > d_abs.z())? 0 : 2) : ((d_abs.y() > d_abs.z())? 1 : 2);
+    unsigned int kx = (kz + 1) % 3, ky = (kx + 1) % 3;
+    // keep winding direction
+    if (dir[kz] < 0) { unsigned int tmp = kx; kx = ky; ky = tmp; }
+    // shear constants
+    float Sx = dir[kx] / dir[kz], Sy = dir[ky] / dir[kz], Sz = 1.0f / dir[kz];
+    // vertices relative to ray origin
+    Vec3f A = A_ - origin, B = B_ - origin, C = C_ - origin;
+    // shear and scale vertices
+    float Ax = A[kx] - Sx * A[kz], Ay = A[ky] - Sy * A[kz];
+    float Bx = B[kx] - Sx * B[kz], By = B[ky] - Sy * B[kz];
+    float Cx = C[kx] - Sx * C[kz], Cy = C[ky] - Sy * C[kz];
+    // scaled barycentric coordinates - edges count as inside for both adjacent triangles
+    float U = Cx * By - Cy * Bx;
+    float V = Ax * Cy - Ay * Cx;
+    float W = Bx * Ay - By * Ax;
+    if (((U < 0) || (V < 0) || (W < 0)) && ((U > 0) || (V > 0) || (W > 0))) return false;
+    // ray parallel to triangle
+    float det = U + V + W;
+    if (det == 0) return false;
+    // distance along ray
+    float T = U * Sz * A[kz] + V * Sz * B[kz] + W * Sz * C[kz];
+    *t = T / det;
+    return *t >= EPS;
+}
+
+// packet version of triangle_intersect - the axis permutation is chosen per lane
+static Float8 triangle_intersect_packet(const Vec3f A_, const Vec3f B_, const Vec3f C_, const Vec3f8& origin, const Vec3f8& dir, Float8* t) {
+    // permute axes so that the ray travels mostly along z - axis indices are stored as floats
+    Float8 ax = Float8::abs(dir.x), ay = Float8::abs(dir.y), az = Float8::abs(dir.z);
+    Float8 kz = Float8::select(ax > ay, Float8::select(ax > az, 0, 2), Float8::select(ay > az, 1, 2));
+    Float8 kx = Float8::select(kz == Float8(2), 0, kz + Float8(1));
+    Float8 ky = Float8::select(kx == Float8(2), 0, kx + Float8(1));
+    // keep winding direction
+    Float8 dz = dir.axis(kz);
+    Float8 flip = dz < Float8(0);
+    Float8 tmp = kx; kx = Float8::select(flip, ky, kx); ky = Float8::select(flip, tmp, ky);
+    // shear constants
+    Float8 Sx = dir.axis(kx) / dz, Sy = dir.axis(ky) / dz, Sz = Float8(1.0f) / dz;
+    // vertices relative to ray origin
+    Vec3f8 A = Vec3f8(A_) - origin, B = Vec3f8(B_) - origin, C = Vec3f8(C_) - origin;
+    Float8 Az = A.axis(kz), Bz = B.axis(kz), Cz = C.axis(kz);
+    // shear and scale vertices
+    Float8 Ax = A.axis(kx) - Sx * Az, Ay = A.axis(ky) - Sy * Az;
+    Float8 Bx = B.axis(kx) - Sx * Bz, By = B.axis(ky) - Sy * Bz;
+    Float8 Cx = C.axis(kx) - Sx * Cz, Cy = C.axis(ky) - Sy * Cz;
+    // scaled barycentric coordinates - edges count as inside for both adjacent triangles
+    Float8 U = Cx * By - Cy * Bx;
+    Float8 V = Ax * Cy - Ay * Cx;
+    Float8 W = Bx * Ay - By * Ax;
+    Float8 zero(0.0f);
+    Float8 outside = ((U < zero) | (V < zero) | (W < zero)) & ((U > zero) | (V > zero) | (W > zero));
+    // ray parallel to triangle
+    Float8 det = U + V + W;
+    // distance along ray
+    Float8 T = U * Sz * Az + V * Sz * Bz + W * Sz * Cz;
+    *t = T / det;
+    return (det != zero).andnot(outside) & (*t >= Float8(EPS));
+}
+
+
+/* Geometry */
+
+Float8 Geometry::cast_packet(const Vec3f8& origin, const Vec3f8& dir, Float8* t) const {
+    // cast each lane on its own
+    float t_[PACKET_SIZE], hit[PACKET_SIZE];
+    for (int i = 0; i < PACKET_SIZE; i++) {
+        hit[i] = this->cast(origin[i], dir[i], &t_[i])? 1.0f : 0.0f;
+    }
+    *t = Float8::load(t_);
+    return Float8::load(hit) != Float8(0.0f);
+}
+
 
 /* Sphere */
 
@@ -50,6 +137,22 @@ bool Sphere::cast(const Vec3f origin, const Vec3f dir, float* t) const {
     return *t > 0;
 }
 
+Float8 Sphere::cast_packet(const Vec3f8& origin, const Vec3f8& dir, Float8* t) const {
+    // same quadratic as the single ray version
+    Vec3f8 L = origin - Vec3f8(this->get_center());
+    float radius = this->get_radius();
+    Float8 a = Vec3f8::dot(dir, dir);
+    Float8 b = Float8(2) * Vec3f8::dot(dir, L);
+    Float8 c = Vec3f8::dot(L, L) - Float8(radius * radius);
+    Float8 discr = b * b - Float8(4) * a * c;
+    // one intersection if the discriminant is zero, closer one of two otherwise
+    Float8 root = Float8::sqrt(discr);
+    Float8 q = Float8(-0.5f) * Float8::select(b > Float8(0), b + root, b - root);
+    Float8 one = Float8(-0.5f) * b / a;
+    *t = Float8::select(discr == Float8(0), one, Float8::min(q / a, c / q));
+    return (discr >= Float8(0)) & (*t > Float8(0));
+}
+
 // normal at specified position on surface
 Vec3f Sphere::normal(const Vec3f p) const {
     // compute normal vector
@@ -57,6 +160,15 @@ Vec3f Sphere::normal(const Vec3f p) const {
     return n;
 }
 
+// bounding box
+bool Sphere::bounds(Vec3f* min, Vec3f* max) const {
+    // negative radii are used for hollow spheres
+    float r = fabs(this->get_radius());
+    *min = this->get_center() - r;
+    *max = this->get_center() + r;
+    return true;
+}
+
 
 /* Plane */
 
@@ -94,6 +206,17 @@ bool Plane::cast(const Vec3f origin, const Vec3f dir, float* t) const {
     return false; 
 }
 
+Float8 Plane::cast_packet(const Vec3f8& origin, const Vec3f8& dir, Float8* t) const {
+    // normal facing towards each ray origin
+    Vec3f8 n = Vec3f8(this->get_normal());
+    Vec3f8 p = Vec3f8(this->get_origin()) - origin;
+    Vec3f8 normal = Vec3f8::select(Vec3f8::dot(p, n) < Float8(0), n, n * Float8(-1));
+    // distance to intersection point for rays facing the plane
+    Float8 denom = Vec3f8::dot(normal, dir);
+    *t = Vec3f8::dot(p, normal) / denom;
+    return (denom < Float8(-EPS)) & (*t >= Float8(EPS));
+}
+
 
 // normal of plane
 Vec3f Plane::normal(Vec3f p) const { 
@@ -104,8 +227,11 @@ Vec3f Plane::normal(Vec3f p) const {
     return (Vec3f::dot(u, normal) < 0)? normal : (normal * -1);
 }
 
+// planes are infinite
+bool Plane::bounds(Vec3f*, Vec3f*) const { return false; }
 
-/* Plane */
+
+/* Triangle */
 
 // Config
 TriangleConfig::TriangleConfig(Vec3f A, Vec3f B, Vec3f C): A(A), B(B), C(C) {}
@@ -131,29 +257,13 @@ void Triangle::apply(Config* config) {
 
 // ray-cast method
 bool Triangle::cast(const Vec3f origin, const Vec3f dir, float* t) const {
-    // check plane intersection
-    if (!Plane::cast(origin, dir, t)) return false;
-    // check if intersection point is in triangle
-    Vec3f P = origin + dir * (*t);
+    // watertight intersection
+    return triangle_intersect(this->get_A(), this->get_B(), this->get_C(), origin, dir, t);
+}
 
-    // check with all edges of the triangle
-    Vec3f A = this->get_A();
-    Vec3f B = this->get_B();
-    Vec3f C = this->get_C();
-    // get unnormalized normal pointing towards origin of ray
-    Vec3f normal = Vec3f::cross(A - B, A - C);
-    normal = normal * ((Vec3f::dot(A - origin, normal) < 0)? 1 : -1);
-    // AB
-    Vec3f AB_AP = Vec3f::cross(B - A, P - A);    
-    if (Vec3f::dot(AB_AP, normal) > 0) return false;
-    // BC
-    Vec3f BC_BP = Vec3f::cross(C - B, P - B);    
-    if (Vec3f::dot(BC_BP, normal) > 0) return false;
-    // CA
-    Vec3f CA_CP = Vec3f::cross(A - C, P - C);    
-    if (Vec3f::dot(CA_CP, normal) > 0) return false;
-    // P is inside triangle
-    return true;
+Float8 Triangle::cast_packet(const Vec3f8& origin, const Vec3f8& dir, Float8* t) const {
+    // watertight intersection
+    return triangle_intersect_packet(this->get_A(), this->get_B(), this->get_C(), origin, dir, t);
 }
 
 
@@ -168,4 +278,172 @@ Vec3f Triangle::normal(Vec3f p) const {
     // compute normal facing towards given point
     Vec3f normal = Vec3f::cross(v, w).normalize();
     return (Vec3f::dot(u, normal) < 0)? normal : (normal * -1);
-}
\ No newline at end of file
+}
+
+// bounding box
+bool Triangle::bounds(Vec3f* min, Vec3f* max) const {
+    Vec3f A = this->get_A(), B = this->get_B(), C = this->get_C();
+    // component-wise extrema of all corners
+    *min = Vec3f(fminf(A.x(), fminf(B.x(), C.x())), fminf(A.y(), fminf(B.y(), C.y())), fminf(A.z(), fminf(B.z(), C.z())));
+    *max = Vec3f(fmaxf(A.x(), fmaxf(B.x(), C.x())), fmaxf(A.y(), fmaxf(B.y(), C.y())), fmaxf(A.z(), fmaxf(B.z(), C.z())));
+    return true;
+}
+
+
+/* Triangle Mesh */
+
+// Mesh Buffer
+MeshBuffer::MeshBuffer(void) {
+    // create vectors
+    this->vertices_ = new vector<float>();
+    this->indices_ = new vector<unsigned int>();
+}
+
+MeshBuffer::~MeshBuffer(void) {
+    // delete vectors
+    delete this->vertices_;
+    delete this->indices_;
+}
+
+unsigned int MeshBuffer::add(const vector<Vec3f>* vertices, const vector<unsigned int>* indices) {
+    unsigned int first_vertex = this->vertices_->size() / 3;
+    unsigned int first_triangle = this->n_triangles();
+    // reject indices reading past the vertices of the mesh before changing anything
+    if (indices->size() % 3 != 0) throw InvalidMeshIndices();
+    for (unsigned int i : *indices) { if (i >= vertices->size()) throw InvalidMeshIndices(); }
+    // append vertices
+    for (const Vec3f& v : *vertices) {
+        this->vertices_->push_back(v.x());
+        this->vertices_->push_back(v.y());
+        this->vertices_->push_back(v.z());
+    }
+    // append indices shifted to the new vertices
+    for (unsigned int i : *indices) { this->indices_->push_back(first_vertex + i); }
+    this->version_++;
+    // return first triangle of mesh
+    return first_triangle;
+}
+
+Vec3f MeshBuffer::vertex(unsigned int triangle, unsigned int corner) const {
+    // look up vertex of corner
+    const float* v = this->vertices_->data() + 3 * (*this->indices_)[3 * triangle + corner];
+    return Vec3f(v[0], v[1], v[2]);
+}
+
+// Config
+TriangleMeshConfig::TriangleMeshConfig(vector<Vec3f> vertices, vector<unsigned int> indices): vertices(vertices), indices(indices) {}
+
+TriangleMeshConfig* TriangleMeshConfig::from_obj(const char* fname) {
+    // open file
+    ifstream file(fname);
+    if (!file.is_open()) throw FileNotFound();
+    // read vertices and faces line by line
+    vector<Vec3f> vertices; vector<unsigned int> indices;
+    string line;
+    while (getline(file, line)) {
+        istringstream ss(line);
+        string key; ss >> key;
+        if (key == "v") {
+            // vertex position
+            float x, y, z; ss >> x >> y >> z;
+            vertices.push_back(Vec3f(x, y, z));
+        } else if (key == "f") {
+            // face - only vertex indices of "v", "v/vt", "v//vn" and "v/vt/vn" are used
+            vector<unsigned int> face; string corner;
+            while (ss >> corner) {
+                string index = corner.substr(0, corner.find('/'));
+                char* end = nullptr;
+                long i = strtol(index.c_str(), &end, 10);
+                if (index.empty() || (*end != '\0')) throw InvalidObjFile();
+                // obj indices start at one and negative ones count from the end - zero is invalid
+                long k = (i > 0)? i - 1 : (long)vertices.size() + i;
+                if ((i == 0) || (k < 0) || (k >= (long)vertices.size())) throw InvalidObjFile();
+                face.push_back(k);
+            }
+            // triangulate polygon as fan
+            for (unsigned int k = 2; k < face.size(); k++) {
+                indices.push_back(face[0]); indices.push_back(face[k - 1]); indices.push_back(face[k]);
+            }
+        }
+    }
+    // create config
+    return new TriangleMeshConfig(vertices, indices);
+}
+
+// getters
+unsigned int TriangleMesh::first_triangle(void) const { return this->read(1); }
+unsigned int TriangleMesh::n_primitives(void) const { return this->read(2); }
+// setters
+void TriangleMesh::set_triangles(unsigned int first, unsigned int n) { this->write(1, first); this->write(2, n); }
+
+// apply config
+void TriangleMesh::apply(Config* config) {
+    // convert config
+    TriangleMeshConfig* config_ = (TriangleMeshConfig*)config;
+    // reference shared buffer holding the triangles
+    this->buffer = config_->buffer;
+    this->set_triangles(config_->first_triangle, config_->indices.size() / 3);
+}
+
+// single triangles
+bool TriangleMesh::primitive_cast(unsigned int prim, const Vec3f origin, const Vec3f dir, float* t) const {
+    // watertight intersection with triangle of mesh
+    unsigned int i = this->first_triangle() + prim;
+    return triangle_intersect(this->buffer->vertex(i, 0), this->buffer->vertex(i, 1), this->buffer->vertex(i, 2), origin, dir, t);
+}
+
+Float8 TriangleMesh::primitive_cast_packet(unsigned int prim, const Vec3f8& origin, const Vec3f8& dir, Float8* t) const {
+    // watertight intersection of packet with triangle of mesh
+    unsigned int i = this->first_triangle() + prim;
+    return triangle_intersect_packet(this->buffer->vertex(i, 0), this->buffer->vertex(i, 1), this->buffer->vertex(i, 2), origin, dir, t);
+}
+
+Vec3f TriangleMesh::primitive_normal(unsigned int prim, const Vec3f p) const {
+    unsigned int i = this->first_triangle() + prim;
+    Vec3f A = this->buffer->vertex(i, 0);
+    // compute normal facing towards given point
+    Vec3f normal = Vec3f::cross(A - this->buffer->vertex(i, 1), A - this->buffer->vertex(i, 2)).normalize();
+    return (Vec3f::dot(A - p, normal) < 0)? normal : (normal * -1);
+}
+
+bool TriangleMesh::primitive_bounds(unsigned int prim, Vec3f* min, Vec3f* max) const {
+    unsigned int i = this->first_triangle() + prim;
+    Vec3f A = this->buffer->vertex(i, 0), B = this->buffer->vertex(i, 1), C = this->buffer->vertex(i, 2);
+    // component-wise extrema of all corners
+    *min = Vec3f(fminf(A.x(), fminf(B.x(), C.x())), fminf(A.y(), fminf(B.y(), C.y())), fminf(A.z(), fminf(B.z(), C.z())));
+    *max = Vec3f(fmaxf(A.x(), fmaxf(B.x(), C.x())), fmaxf(A.y(), fmaxf(B.y(), C.y())), fmaxf(A.z(), fmaxf(B.z(), C.z())));
+    return true;
+}
+
+// whole mesh
+bool TriangleMesh::cast(const Vec3f origin, const Vec3f dir, float* t) const {
+    bool hit = false;
+    *t = numeric_limits<float>::max();
+    // closest intersection over all triangles
+    for (unsigned int k = 0; k < this->n_primitives(); k++) {
+        float t_;
+        if (this->primitive_cast(k, origin, dir, &t_) && (t_ < *t)) { hit = true; *t = t_; }
+    }
+    return hit;
+}
+
+Vec3f TriangleMesh::normal(Vec3f p) const {
+    // without a primitive index use the triangle whose plane is closest to p
+    unsigned int closest = 0; float closest_dist = numeric_limits<float>::max();
+    for (unsigned int k = 0; k < this->n_primitives(); k++) {
+        Vec3f n = this->primitive_normal(k, p);
+        float dist = fabs(Vec3f::dot(this->buffer->vertex(this->first_triangle() + k, 0) - p, n));
+        if (dist < closest_dist) { closest = k; closest_dist = dist; }
+    }
+    return this->primitive_normal(closest, p);
+}
+
+bool TriangleMesh::bounds(Vec3f* min, Vec3f* max) const {
+    // union of all triangle bounds
+    for (unsigned int k = 0; k < this->n_primitives(); k++) {
+        Vec3f tmin, tmax; this->primitive_bounds(k, &tmin, &tmax);
+        *min = (k == 0)? tmin : Vec3f(fminf(min->x(), tmin.x()), fminf(min->y(), tmin.y()), fminf(min->z(), tmin.z()));
+        *max = (k == 0)? tmax : Vec3f(fmaxf(max->x(), tmax.x()), fmaxf(max->y(), tmax.y()), fmaxf(max->z(), tmax.z()));
+    }
+    return this->n_primitives() > 0;
+}
@@ -1,3 +1,4 @@
+#pragma once
 #include "include/_defines.h"
 #include "src/kernels/ray.cl"
 #include "src/kernels/structs.cl"
@@ -29,9 +30,9 @@ int camera_cast_ray(
     Ray* ray,
     float3* color,
     // containers
-    Container* geometries,
-    Container* materials,
-    Container* lights,
+    GeometryContainer* geometries,
+    MaterialContainer* materials,
+    LightContainer* lights,
     // ambient
     float3 ambient,
     // globals
@@ -46,7 +47,7 @@ int camera_cast_ray(
         unsigned int material_id = geometry_get_material_id(&closest);
         Material material; material_get(material_id, materials, &material);
         // get normal of ray on geometry
-        float3 normal = geometry_get_normal(p, &closest, globals);
+        float3 normal = geometry_get_normal(p, &closest, geometries, globals);
         // get attenuation and light-color
         float3 attenuation = material_get_attenuation(p, ray->direction, normal, &material, globals);
         float3 light_color = light_get_total_light(p, ray->direction, normal, &material, lights, geometries, ambient, globals);
@@ -67,9 +68,9 @@ float3 camera_get_ray_color(
     // initial ray
     Ray* ray,
     // containers
-    Container* geometries,
-    Container* materials,
-    Container* lights,
+    GeometryContainer* geometries,
+    MaterialContainer* materials,
+    LightContainer* lights,
     // ambient color
     float3 ambient,
     // globals
@@ -105,40 +106,58 @@ __kernel void camera_prepare_globals(
 
     // read globals to private address space
     Globals globals = all_globals[i];
-    // initialize seeds for random number generation
-    globals.seed0 = y;
-    globals.seed1 = x;
+    // initialize random number generation - renders reseed every sample
+    random_seed(&globals, 0, i, 0);
     // store globals back in global address space
     all_globals[i] = globals;
 }
 
+int camera_pixel_converged(
+    // accumulated colors and sample statistics of pixel
+    float3 sum, PixelStats stats,
+    // samples per frame
+    unsigned int n_samples,
+    // threshold of standard error and range of samples - zero for no maximum
+    float threshold, unsigned int min_samples, unsigned int max_samples
+) {
+    // same test as Camera::pixel_converged
+    if ((max_samples > 0) && (stats.spp >= max_samples)) return 1;
+    if (stats.spp < min_samples) return 0;
+    // mean luminance over all samples - every frame took the same number of samples
+    float n = stats.spp, frames = stats.spp / n_samples;
+    float mean = (sum.x + sum.y + sum.z) / (3 * frames);
+    float var = fmax((stats.sum_sq / n - mean * mean) * n / (n - 1), 0.0f);
+    // standard error after gamma correction - the square root scales errors by 1 / (2 sqrt(mean))
+    return sqrt(var / n) <= 2 * threshold * sqrt(mean);
+}
+
 __kernel void camera_get_pixel_color(
     // pixel array (rgba-format)
     __global unsigned char* pixels,
     // geometries
     __global float*         geometry_data,
-    __global unsigned int*  geometry_ids,
+    __global unsigned int*  geometry_table,
     unsigned int            n_geometries,
     unsigned int            n_geometry_bytes,
     // local geometry memory
     __local float*          loc_geometry_data,
-    __local unsigned int*   loc_geometry_ids,
+    __local unsigned int*   loc_geometry_table,
     // materials
     __global float*         material_data,
-    __global unsigned int*  material_ids,
+    __global unsigned int*  material_table,
     unsigned int            n_materials,
     unsigned int            n_material_bytes,
     // local material memory
     __local float*          loc_material_data,
-    __local unsigned int*   loc_material_ids,
+    __local unsigned int*   loc_material_table,
     // lights
     __global float*         light_data,
-    __global unsigned int*  light_ids,
+    __global unsigned int*  light_table,
     unsigned int            n_lights,    
     unsigned int            n_light_bytes,
     // local material memory
     __local float*          loc_light_data,
-    __local unsigned int*   loc_light_ids,
+    __local unsigned int*   loc_light_table,
     // camera orientation
     float cam_x, float cam_y, float cam_z,
     float cam_u, float cam_v, float cam_w,
@@ -149,33 +168,72 @@ __kernel void camera_get_pixel_color(
     // ambient color
     float ambient_r, float ambient_g, float ambient_b,
     // globals
-    __global Globals* all_globals
+    __global Globals* all_globals,
+    // bounding volume hierarchy over geometries
+    __global BVHNode*       bvh_nodes,
+    __global BVHPrimitive*  bvh_prims,
+    unsigned int            n_bvh_nodes,
+    unsigned int            n_bvh_unbounded,
+    // shared triangle mesh buffer
+    __global float*         mesh_vertices,
+    __global unsigned int*  mesh_indices,
+    // spheres of bvh primitives in structure-of-arrays layout
+    __global float*         bvh_spheres,
+    unsigned int            bvh_sphere_stride,
+    // top levels of bounding volume hierarchy copied to local memory
+    __local BVHNode*        loc_bvh_nodes,
+    unsigned int            n_loc_bvh_nodes,
+    // alias table to pick lights by power
+    __global LightAlias*    light_alias,
+    // sum of colors of previous frames (rgb-format)
+    __global float*         accum,
+    unsigned int            n_accumulated,
+    // seed of random numbers
+    unsigned int            seed,
+    // size of whole image - the range may only cover a band of rows starting at its offset
+    unsigned int            image_height,
+    unsigned int            image_width,
+    // end of band - the range is padded to whole work-groups beyond it
+    unsigned int            row_end,
+    // adaptive sampling - threshold of standard error and range of samples of each pixel
+    float                   adaptive_threshold,
+    unsigned int            adaptive_min_samples,
+    unsigned int            adaptive_max_samples,
+    // sample statistics of each pixel over the accumulated frames
+    __global PixelStats*    pixel_stats
 ) {
     // get indices
     unsigned int y = get_global_id(0);
     unsigned int x = get_global_id(1);
     // get image size
-    unsigned int h = get_global_size(0);
-    unsigned int w = get_global_size(1);
+    unsigned int h = image_height;
+    unsigned int w = image_width;
     // compute flatten index
     unsigned int i = x + y * w;
+    // work-items of the padding only help to stage the scene
+    int inside = (x < w) && (y < row_end);
 
     // read globals to private memory
-    Globals globals = all_globals[i];
+    Globals globals;
+    if (inside) globals = all_globals[i];
 
-    // read ids to local memory
-    global_to_local((__global char*)geometry_ids, (__local char*)loc_geometry_ids, n_geometries * sizeof(unsigned int));
-    global_to_local((__global char*)material_ids, (__local char*)loc_material_ids, n_materials * sizeof(unsigned int));
-    global_to_local((__global char*)light_ids,    (__local char*)loc_light_ids,    n_lights * sizeof(unsigned int));
-    // read data to local memory
-    global_to_local((__global char*)geometry_data, (__local char*)loc_geometry_data, n_geometry_bytes);
-    global_to_local((__global char*)material_data, (__local char*)loc_material_data, n_material_bytes);
-    global_to_local((__global char*)light_data,    (__local char*)loc_light_data,    n_light_bytes);
+    // read instance tables (type ids followed by data offsets) to local memory unless they stay in global memory
+    GEOMETRY_SPACE unsigned int* geometry_ids = GEOMETRY_STAGE(geometry_table, loc_geometry_table, 2 * n_geometries * sizeof(unsigned int));
+    MATERIAL_SPACE unsigned int* material_ids = MATERIAL_STAGE(material_table, loc_material_table, 2 * n_materials * sizeof(unsigned int));
+    LIGHT_SPACE unsigned int*    light_ids    = LIGHT_STAGE(light_table,       loc_light_table,    2 * n_lights * sizeof(unsigned int));
+    // read data to local memory unless it stays in global memory
+    GEOMETRY_SPACE float* geometry_values = GEOMETRY_STAGE(geometry_data, loc_geometry_data, n_geometry_bytes);
+    MATERIAL_SPACE float* material_values = MATERIAL_STAGE(material_data, loc_material_data, n_material_bytes);
+    LIGHT_SPACE float*    light_values    = LIGHT_STAGE(light_data,       loc_light_data,    n_light_bytes);
+    // read top levels of hierarchy to local memory
+    global_to_local((__global char*)bvh_nodes, (__local char*)loc_bvh_nodes, n_loc_bvh_nodes * sizeof(BVHNode));
 
     // create containers
-    Container geometries = (Container){loc_geometry_data, loc_geometry_ids, n_geometries};
-    Container materials  = (Container){loc_material_data, loc_material_ids, n_materials};
-    Container lights     = (Container){loc_light_data,    loc_light_ids,    n_lights};
+    GeometryContainer geometries = (GeometryContainer){geometry_values, geometry_ids, geometry_ids + n_geometries, n_geometries, bvh_nodes, bvh_prims, n_bvh_nodes, n_bvh_unbounded, mesh_vertices, mesh_indices, bvh_spheres, bvh_sphere_stride, loc_bvh_nodes, n_loc_bvh_nodes};
+    MaterialContainer materials  = (MaterialContainer){material_values, material_ids, material_ids + n_materials, n_materials};
+    LightContainer lights        = (LightContainer){light_values,       light_ids,    light_ids + n_lights,       n_lights, light_alias};
+    // all work-items passed the barriers of the staging
+    if (!inside) return;
 
     // create camera
     Camera cam = (Camera) {
@@ -188,21 +246,51 @@ __kernel void camera_get_pixel_color(
     // create ambient light color
     float3 ambient = (float3) (ambient_r, ambient_g, ambient_b);
 
-    // initialize color with ray throu middle of pixel
-    Ray ray; camera_get_ray_throu_pixel(&ray, x, y, w, h, cam, &globals);
-    float3 color = camera_get_ray_color(&ray, &geometries, &materials, &lights, ambient, &globals);
-    // antialiasing
-    for (int j = 0; j < antialiasing_n_samples - 1; j++) {
-        // get random offset from pixel center
-        float u = 2 * randf(&globals) - 1;
-        float v = 2 * randf(&globals) - 1;
-        // create ray throu pixel and get its color
-        Ray ray; camera_get_ray_throu_pixel(&ray, x + u, y+ v, w, h, cam, &globals);
-        color += camera_get_ray_color(&ray, &geometries, &materials, &lights, ambient, &globals);
+    // sample count may be fixed at build time so the loop can be unrolled
+#ifdef ANTIALIASING_N_SAMPLES
+    const unsigned int n_samples = ANTIALIASING_N_SAMPLES;
+#else
+    const unsigned int n_samples = antialiasing_n_samples;
+#endif
+    // colors and statistics of previous frames - the first frame overrides old values
+    float3 sum = (float3)(0.0f, 0.0f, 0.0f);
+    PixelStats stats = (PixelStats){ 0, 0.0f };
+    if (n_accumulated > 0) { sum = vload3(i, accum); stats = pixel_stats[i]; }
+#ifdef ADAPTIVE_SAMPLING
+    // converged pixels take no more samples
+    if ((n_accumulated == 0) || !camera_pixel_converged(sum, stats, n_samples, adaptive_threshold, adaptive_min_samples, adaptive_max_samples)) {
+#else
+    {
+#endif
+        // antialiasing - each sample draws from its own stream of the pixel
+        float3 color = (float3)(0.0f, 0.0f, 0.0f);
+        float sum_sq = 0;
+        for (unsigned int j = 0; j < n_samples; j++) {
+            random_seed(&globals, seed, i, n_accumulated * n_samples + j);
+            // first ray goes throu middle of pixel, others get a random offset from pixel center
+            float u = 0, v = 0;
+            if (j > 0) {
+                u = 2 * randf(&globals) - 1;
+                v = 2 * randf(&globals) - 1;
+            }
+            // create ray throu pixel and get its color
+            Ray ray; camera_get_ray_throu_pixel(&ray, x + u, y + v, w, h, cam, &globals);
+            float3 c = camera_get_ray_color(&ray, &geometries, &materials, &lights, ambient, &globals);
+            color += c;
+            // second moment of luminance for adaptive sampling
+            float l = (c.x + c.y + c.z) / 3;
+            sum_sq += l * l;
+        }
+        // average samples of this frame and accumulate with previous frames
+        color /= n_samples;
+        if (n_accumulated > 0) color += sum;
+        sum = color;
+        vstore3(sum, i, accum);
+        stats.spp += n_samples; stats.sum_sq += sum_sq;
+        pixel_stats[i] = stats;
     }
-
-    // apply gamma correction
-    color = sqrt(color / antialiasing_n_samples);
+    // apply gamma correction on average of all frames the pixel was sampled in
+    float3 color = sqrt(sum / (stats.spp / n_samples));
     // clamp color values between 0 and 255
     color = clamp(color, 0.0f, 1.0f); color *= 255;
     // apply color to pixel
@@ -213,4 +301,7 @@ __kernel void camera_get_pixel_color(
 
     // save globals for next iteration
     all_globals[i] = globals;
-}
\ No newline at end of file
+}
+
+// alternative wavefront pipeline
+#include "src/kernels/wavefront.cl"
@@ -11,12 +11,9 @@ float3 sphere_get_center(Geometry* geometry) {
     return (float3)(geometry->data[1], geometry->data[2], geometry->data[3]);
 }
 
-int sphere_cast(Ray* ray, Geometry* geometry, float* t, Globals* globals) {
-    // get sphere information
-    float3 center = sphere_get_center(geometry);
-    float radius = geometry->data[4];
+int sphere_intersect(Ray* ray, float3 center, float radius, float* t) {
     // analytic solution of sphere-ray-intersection
-    float3 L = ray->origin - sphere_get_center(geometry);
+    float3 L = ray->origin - center;
     float b = dot(ray->direction, L) * 2;
     float c = dot(L, L) - (radius * radius);
     // solve quadratic function
@@ -36,6 +33,21 @@ int sphere_cast(Ray* ray, Geometry* geometry, float* t, Globals* globals) {
     return (*t > 0);
 }
 
+int sphere_cast(Ray* ray, Geometry* geometry, float* t, Globals* globals) {
+    // get sphere information
+    float3 center = sphere_get_center(geometry);
+    float radius = geometry->data[4];
+    return sphere_intersect(ray, center, radius, t);
+}
+
+int sphere_cast_stored(Ray* ray, GeometryContainer* geometries, unsigned int i, float* t) {
+    // read sphere of primitive i from the structure-of-arrays copy - neighbouring work-items load neighbouring floats
+    __global float* sphere = geometries->spheres + i;
+    unsigned int stride = geometries->sphere_stride;
+    float3 center = (float3)(sphere[0], sphere[stride], sphere[2 * stride]);
+    return sphere_intersect(ray, center, sphere[3 * stride], t);
+}
+
 float3 sphere_normal(float3 p, Geometry* geometry, Globals* globals){
     // get sphere information
     float3 center = sphere_get_center(geometry);
@@ -85,6 +97,39 @@ float3 plane_normal(float3 p, Geometry* geometry, Globals* globals) {
 
 /*** Triangle ***/
 
+int _triangle_intersect(Ray* ray, float3 A, float3 B, float3 C, float* t) {
+    // watertight ray-triangle intersection (Woop, Benthin, Wald 2013) - mirrors triangle_intersect in geometry.cpp
+    float3 d_abs = fabs(ray->direction);
+    // permute axes so that the ray travels mostly along z
+    unsigned int kz = (d_abs.x > d_abs.y)? ((d_abs.x > d_abs.z)? 0 : 2) : ((d_abs.y > d_abs.z)? 1 : 2);
+    unsigned int kx = (kz + 1) % 3, ky = (kx + 1) % 3;
+    // keep winding direction
+    float dz = float3_get(ray->direction, kz);
+    if (dz < 0) { unsigned int tmp = kx; kx = ky; ky = tmp; }
+    // shear constants
+    float Sx = float3_get(ray->direction, kx) / dz;
+    float Sy = float3_get(ray->direction, ky) / dz;
+    float Sz = 1.0f / dz;
+    // vertices relative to ray origin
+    A -= ray->origin; B -= ray->origin; C -= ray->origin;
+    float Az = float3_get(A, kz), Bz = float3_get(B, kz), Cz = float3_get(C, kz);
+    // shear and scale vertices
+    float Ax = float3_get(A, kx) - Sx * Az, Ay = float3_get(A, ky) - Sy * Az;
+    float Bx = float3_get(B, kx) - Sx * Bz, By = float3_get(B, ky) - Sy * Bz;
+    float Cx = float3_get(C, kx) - Sx * Cz, Cy = float3_get(C, ky) - Sy * Cz;
+    // scaled barycentric coordinates - edges count as inside for both adjacent triangles
+    float U = Cx * By - Cy * Bx;
+    float V = Ax * Cy - Ay * Cx;
+    float W = Bx * Ay - By * Ax;
+    if (((U < 0) || (V < 0) || (W < 0)) && ((U > 0) || (V > 0) || (W > 0))) return 0;
+    // ray parallel to triangle
+    float det = U + V + W;
+    if (det == 0) return 0;
+    // distance along ray
+    *t = (U * Sz * Az + V * Sz * Bz + W * Sz * Cz) / det;
+    return (*t >= EPS);
+}
+
 float3 _triangle_normal(float3 p, float3 A, float3 B, float3 C) {
     // get direction
     float3 u = A - p;
@@ -109,28 +154,8 @@ float3 triangle_get_C(Geometry* geometry) {
 }
 
 int triangle_cast(Ray* ray, Geometry* geometry, float* t, Globals* globals) {
-    // create Triangle from data
-    float3 A = triangle_get_A(geometry);
-    float3 B = triangle_get_B(geometry);
-    float3 C = triangle_get_C(geometry);
-    // get unnormalized normal of triangle
-    float3 normal = _triangle_normal(ray->origin, A, B, C);
-    // cast ray to plane
-    if (!_plane_cast(ray, A, normal, t)) return 0;
-    // get point of intersection
-    float3 P = ray_advance(ray, *t);
-    // check with all edges of the triangle
-    // AB
-    float3 AB_AP = cross(B - A, P - A);
-    if (dot(AB_AP, normal) > 0) return 0;
-    // AB
-    float3 BC_BP = cross(C - B, P - B);
-    if (dot(BC_BP, normal) > 0) return 0;
-    // AB
-    float3 CA_CP = cross(A - C, P - C);
-    if (dot(CA_CP, normal) > 0) return 0;
-    // P is inside triangle
-    return 1;
+    // watertight intersection with triangle from data
+    return _triangle_intersect(ray, triangle_get_A(geometry), triangle_get_B(geometry), triangle_get_C(geometry), t);
 }
 
 float3 triangle_normal(float3 p, Geometry* geometry, Globals* globals) {
@@ -142,32 +167,88 @@ float3 triangle_normal(float3 p, Geometry* geometry, Globals* globals) {
     return normalize(_triangle_normal(p, A, B, C));
 }
 
+
+/*** Triangle Mesh ***/
+
+float3 _trianglemesh_get_vertex(__global float* vertices, unsigned int vertex) {
+    // return vertex from shared mesh buffer
+    return (float3)(vertices[3 * vertex], vertices[3 * vertex + 1], vertices[3 * vertex + 2]);
+}
+
+void trianglemesh_get_triangle(Geometry* geometry, GeometryContainer* geometries, float3* A, float3* B, float3* C) {
+    // indices of triangle selected by the primitive index
+    __global unsigned int* idx = geometries->indices + 3 * ((unsigned int)geometry->data[1] + geometry->index);
+    // look up corners
+    *A = _trianglemesh_get_vertex(geometries->vertices, idx[0]);
+    *B = _trianglemesh_get_vertex(geometries->vertices, idx[1]);
+    *C = _trianglemesh_get_vertex(geometries->vertices, idx[2]);
+}
+
+int trianglemesh_cast(Ray* ray, Geometry* geometry, GeometryContainer* geometries, float* t, Globals* globals) {
+    // cast to triangle of mesh
+    float3 A, B, C; trianglemesh_get_triangle(geometry, geometries, &A, &B, &C);
+    return _triangle_intersect(ray, A, B, C, t);
+}
+
+float3 trianglemesh_normal(float3 p, Geometry* geometry, GeometryContainer* geometries, Globals* globals) {
+    // return normalized normal of triangle facing towards p
+    float3 A, B, C; trianglemesh_get_triangle(geometry, geometries, &A, &B, &C);
+    return normalize(_triangle_normal(p, A, B, C));
+}
+
 /*** functions ***/
 
 unsigned int geometry_get_type_size(unsigned int geometry_type) {
     // return size of type specified by type-id
     switch(geometry_type) {
+#ifdef GEOMETRY_SPHERE_ENABLED
         case (GEOMETRY_SPHERE_TYPE_ID):     return GEOMETRY_SPHERE_TYPE_SIZE;
+#endif
+#ifdef GEOMETRY_PLANE_ENABLED
         case (GEOMETRY_PLANE_TYPE_ID):      return GEOMETRY_PLANE_TYPE_SIZE;
+#endif
+#ifdef GEOMETRY_TRIANGLE_ENABLED
         case (GEOMETRY_TRIANGLE_TYPE_ID):   return GEOMETRY_TRIANGLE_TYPE_SIZE;
+#endif
+#ifdef GEOMETRY_TRIANGLEMESH_ENABLED
+        case (GEOMETRY_TRIANGLEMESH_TYPE_ID): return GEOMETRY_TRIANGLEMESH_TYPE_SIZE;
+#endif
     }
 }
 
-int geometry_cast_ray(Ray* ray, Geometry* geometry, float* t, Globals* globals) {
+int geometry_cast_ray(Ray* ray, Geometry* geometry, GeometryContainer* geometries, float* t, Globals* globals) {
     // cast to geometry specified by type-id
     switch(geometry->type_id) {
+#ifdef GEOMETRY_SPHERE_ENABLED
         case (GEOMETRY_SPHERE_TYPE_ID):     return sphere_cast(ray, geometry, t, globals);
+#endif
+#ifdef GEOMETRY_PLANE_ENABLED
         case (GEOMETRY_PLANE_TYPE_ID):      return plane_cast(ray, geometry, t, globals);
+#endif
+#ifdef GEOMETRY_TRIANGLE_ENABLED
         case (GEOMETRY_TRIANGLE_TYPE_ID):   return triangle_cast(ray, geometry, t, globals);
+#endif
+#ifdef GEOMETRY_TRIANGLEMESH_ENABLED
+        case (GEOMETRY_TRIANGLEMESH_TYPE_ID): return trianglemesh_cast(ray, geometry, geometries, t, globals);
+#endif
     }
 }
 
-float3 geometry_get_normal(float3 p, Geometry* geometry, Globals* globals) {
+float3 geometry_get_normal(float3 p, Geometry* geometry, GeometryContainer* geometries, Globals* globals) {
     // get normal on surface of geometry specified by type and data
     switch(geometry->type_id) {
+#ifdef GEOMETRY_SPHERE_ENABLED
         case (GEOMETRY_SPHERE_TYPE_ID):     return sphere_normal(p, geometry, globals);
+#endif
+#ifdef GEOMETRY_PLANE_ENABLED
         case (GEOMETRY_PLANE_TYPE_ID):      return plane_normal(p, geometry, globals);
+#endif
+#ifdef GEOMETRY_TRIANGLE_ENABLED
         case (GEOMETRY_TRIANGLE_TYPE_ID):   return triangle_normal(p, geometry, globals);
+#endif
+#ifdef GEOMETRY_TRIANGLEMESH_ENABLED
+        case (GEOMETRY_TRIANGLEMESH_TYPE_ID): return trianglemesh_normal(p, geometry, geometries, globals);
+#endif
     }
 }
 
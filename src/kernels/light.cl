@@ -32,28 +32,68 @@ float pointlight_squarred_distance(float3 p, Light* light, Globals* globals) {
 
 float3 light_get_direction(float3 p, Light* light, Globals* globals) {
     switch(light->type_id) {
+#ifdef LIGHT_POINTLIGHT_ENABLED
         case (LIGHT_POINTLIGHT_TYPE_ID): return pointlight_direction(p, light, globals);
+#endif
     }
 }
 
 float3 light_get_color(float3 p, Light* light, Globals* globals) {
     switch(light->type_id) {
+#ifdef LIGHT_POINTLIGHT_ENABLED
         case (LIGHT_POINTLIGHT_TYPE_ID): return pointlight_color(p, light, globals);
+#endif
     }
 }
 
 float light_get_squarred_distance(float3 p, Light* light, Globals* globals) {
     switch(light->type_id) {
+#ifdef LIGHT_POINTLIGHT_ENABLED
         case (LIGHT_POINTLIGHT_TYPE_ID): return pointlight_squarred_distance(p, light, globals);
+#endif
     }
 }
 
 unsigned int light_get_type_size(unsigned int light_type) {
     switch (light_type) {
+#ifdef LIGHT_POINTLIGHT_ENABLED
         case (LIGHT_POINTLIGHT_TYPE_ID): return LIGHT_POINTLIGHT_TYPE_SIZE;
+#endif
     }
 }
 
+float3 light_get_contribution(
+    // index of light in container
+    unsigned int i,
+    // point of interest, direction of vision towards it and normal on reflecting object
+    float3 p, float3 vision_dir, float3 normal,
+    // material of reflecting object
+    Material* material,
+    // lights and geometries in scene
+    LightContainer* lights,
+    GeometryContainer* geometries,
+    // globals
+    Globals* globals
+) {
+    // set current light
+    Light l;
+    l.data = lights->data + lights->offsets[i];
+    l.type_id = lights->type_ids[i];
+    // create ray from point towards light source
+    float3 light_dir = light_get_direction(p, &l, globals);
+    Ray r = (Ray){ p, light_dir };
+    // check angle
+    if (dot(light_dir, normal) <= EPS) return (float3)(0.0f, 0.0f, 0.0f);
+    // check for objects between point and light-source
+    if (ray_occluded(&r, geometries, sqrt(light_get_squarred_distance(p, &l, globals)), globals)) return (float3)(0.0f, 0.0f, 0.0f);
+    // reflect light ray
+    float3 light_reflect = reflect(light_dir, normal);
+    // phong reflection model
+    float diffuse = dot(light_dir, normal) * material_get_diffuse(p, material, globals);
+    float specular = pow(-dot(light_reflect, vision_dir) * material_get_specular(p, material, globals), material_get_shininess(p, material, globals));
+    return light_get_color(p, &l, globals) * (diffuse + specular);
+}
+
 float3 light_get_total_light(
     // point of interest
     float3 p,
@@ -64,39 +104,31 @@ float3 light_get_total_light(
     // material of reflecting object
     Material* material,
     // lights in scene
-    Container* lights,
+    LightContainer* lights,
     // geometries in scene
-    Container* geometries,
+    GeometryContainer* geometries,
     // ambient light color
     float3 ambient,
     // globals
     Globals* globals
 ) {
     float3 color = (float3)ambient;
-    // current light
-    Light l; l.data = lights->data;
+#ifdef LIGHT_SAMPLES
+    // pick lights by power - same alias table walk as LightSampler::sample
+    // dividing by the probability of each pick keeps the mean of all lights
+    for (unsigned int s = 0; s < LIGHT_SAMPLES; s++) {
+        float x = randf(globals) * lights->n;
+        unsigned int k = min((unsigned int)x, lights->n - 1);
+        LightAlias e = lights->alias[k];
+        unsigned int i = ((x - k) < e.prob)? k : e.alias;
+        color += light_get_contribution(i, p, vision_dir, normal, material, lights, geometries, globals) * (1.0f / (LIGHT_SAMPLES * lights->alias[i].pdf));
+    }
+#else
     // loop over all lights
     for (unsigned int i = 0; i < lights->n; i++) {
-        // set current light type
-        l.type_id = lights->type_ids[i];
-        // create ray from point towards light source
-        float3 light_dir = light_get_direction(p, &l, globals);
-        Ray r = (Ray){ p, light_dir };
-        // check angle
-        if (dot(light_dir, normal) <= EPS) continue;
-        // check for objects between point and light-source
-        Geometry closest; float t;
-        if ( (!ray_cast_to_geometries(&r, geometries, &closest, &t, globals)) || (t*t > light_get_squarred_distance(p, &l, globals)) ) {
-            // reflect light ray
-            float3 light_reflect = reflect(light_dir, normal);
-            // phong reflection model
-            float diffuse = dot(light_dir, normal) * material_get_diffuse(p, material, globals);
-            float specular = pow(-dot(light_reflect, vision_dir) * material_get_specular(p, material, globals), material_get_shininess(p, material, globals));
-            // add all together
-            color += light_get_color(p, &l, globals) * (diffuse + specular);
-        }
-        l.data += light_get_type_size(l.type_id);
+        color += light_get_contribution(i, p, vision_dir, normal, material, lights, geometries, globals);
     }
+#endif
     // return resulting color
     return color;
 }
\ No newline at end of file
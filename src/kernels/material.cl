@@ -1,3 +1,4 @@
+#pragma once
 #include "include/_defines.h"
 #include "src/kernels/structs.cl"
 #include "src/kernels/utils.cl"
@@ -131,9 +132,15 @@ int dielectricmaterial_get_scatter_ray(float3 p, float3 v, float3 n, Material* m
 unsigned int material_get_type_size(unsigned int material_type_id) {
     // get type size of type given by type id
     switch (material_type_id) {
+#ifdef MATERIAL_DIFFUSE_ENABLED
         case (MATERIAL_DIFFUSE_TYPE_ID):    return MATERIAL_DIFFUSE_TYPE_SIZE;
+#endif
+#ifdef MATERIAL_METAL_ENABLED
         case (MATERIAL_METAL_TYPE_ID):      return MATERIAL_METAL_TYPE_SIZE;
+#endif
+#ifdef MATERIAL_DIELECTRIC_ENABLED
         case (MATERIAL_DIELECTRIC_TYPE_ID):      return MATERIAL_DIELECTRIC_TYPE_SIZE;
+#endif
     }
 }
 
@@ -147,9 +154,15 @@ float material_get_diffuse(
 ) {
     // get diffuse value
     switch (material->type_id) {
+#ifdef MATERIAL_DIFFUSE_ENABLED
         case (MATERIAL_DIFFUSE_TYPE_ID):    return diffusematerial_get_diffuse(p, material, globals);
+#endif
+#ifdef MATERIAL_METAL_ENABLED
         case (MATERIAL_METAL_TYPE_ID):      return metalmaterial_get_diffuse(p, material, globals);
+#endif
+#ifdef MATERIAL_DIELECTRIC_ENABLED
         case (MATERIAL_DIELECTRIC_TYPE_ID): return dielectricmaterial_get_diffuse(p, material, globals);
+#endif
     }
 }
 
@@ -163,9 +176,15 @@ float material_get_specular(
 ) {
     // get specular value
     switch (material->type_id) {
+#ifdef MATERIAL_DIFFUSE_ENABLED
         case (MATERIAL_DIFFUSE_TYPE_ID):    return diffusematerial_get_specular(p, material, globals);
+#endif
+#ifdef MATERIAL_METAL_ENABLED
         case (MATERIAL_METAL_TYPE_ID):      return metalmaterial_get_specular(p, material, globals);
+#endif
+#ifdef MATERIAL_DIELECTRIC_ENABLED
         case (MATERIAL_DIELECTRIC_TYPE_ID): return dielectricmaterial_get_specular(p, material, globals);
+#endif
     }
 }
 
@@ -179,9 +198,15 @@ float material_get_shininess(
 ) {
     // get shininess value
     switch (material->type_id) {
+#ifdef MATERIAL_DIFFUSE_ENABLED
         case (MATERIAL_DIFFUSE_TYPE_ID):    return diffusematerial_get_shininess(p, material, globals);
+#endif
+#ifdef MATERIAL_METAL_ENABLED
         case (MATERIAL_METAL_TYPE_ID):      return metalmaterial_get_shininess(p, material, globals);
+#endif
+#ifdef MATERIAL_DIELECTRIC_ENABLED
         case (MATERIAL_DIELECTRIC_TYPE_ID): return dielectricmaterial_get_shininess(p, material, globals);
+#endif
     }
 }
 
@@ -195,9 +220,15 @@ float3 material_get_attenuation(
 ) {
     // get attenuation value
     switch (material->type_id) {
+#ifdef MATERIAL_DIFFUSE_ENABLED
         case (MATERIAL_DIFFUSE_TYPE_ID):    return diffusematerial_get_attenuation(p, v, n, material, globals);
+#endif
+#ifdef MATERIAL_METAL_ENABLED
         case (MATERIAL_METAL_TYPE_ID):      return metalmaterial_get_attenuation(p, v, n, material, globals);
+#endif
+#ifdef MATERIAL_DIELECTRIC_ENABLED
         case (MATERIAL_DIELECTRIC_TYPE_ID): return dielectricmaterial_get_attenuation(p, v, n, material, globals);
+#endif
     }
 }
 
@@ -213,9 +244,15 @@ int material_get_scatter_ray(
 ) {
     // get scatter ray
     switch (material->type_id) {
+#ifdef MATERIAL_DIFFUSE_ENABLED
         case (MATERIAL_DIFFUSE_TYPE_ID):    return diffusematerial_get_scatter_ray(p, v, n, material, ray, globals);
+#endif
+#ifdef MATERIAL_METAL_ENABLED
         case (MATERIAL_METAL_TYPE_ID):      return metalmaterial_get_scatter_ray(p, v, n, material, ray, globals);
+#endif
+#ifdef MATERIAL_DIELECTRIC_ENABLED
         case (MATERIAL_DIELECTRIC_TYPE_ID): return dielectricmaterial_get_scatter_ray(p, v, n, material, ray, globals);
+#endif
     }
 }
 
@@ -223,18 +260,13 @@ void material_get(
     // target material id
     unsigned int target_material_id,
     // materials
-    Container* materials,
+    MaterialContainer* materials,
     // resulting material
     Material* material
 ) {
     // make sure to stay in bounds
-    if (target_material_id > materials->n) printf("MaterialID out of bounds!\n");
-    // pointer to material data given by index
-    __local float* target_material_data = materials->data;
-    // go to index
-    for (unsigned int i = 0; i < target_material_id; i++)
-        target_material_data += material_get_type_size(materials->type_ids[i]);
-    // set material
-    material->data = target_material_data;
+    if (target_material_id >= materials->n) printf("MaterialID out of bounds!\n");
+    // look up data of material in offset table
+    material->data = materials->data + materials->offsets[target_material_id];
     material->type_id = materials->type_ids[target_material_id];
 }
@@ -10,35 +10,120 @@ float3 ray_advance(Ray* ray, float t) {
 // include here so ray_advance is defined in geometry.cl
 #include "src/kernels/geometry.cl"
 
+int ray_intersects_box(Ray* ray, float3 inv_dir, BVHNode* node, float t_max) {
+    // slab test on all three axes
+    float3 t0 = ((float3)(node->bmin[0], node->bmin[1], node->bmin[2]) - ray->origin) * inv_dir;
+    float3 t1 = ((float3)(node->bmax[0], node->bmax[1], node->bmax[2]) - ray->origin) * inv_dir;
+    float3 t_near = fmin(t0, t1);
+    float3 t_far = fmax(t0, t1);
+    // enter and exit distances
+    float t_enter = fmax(fmax(fmax(t_near.x, t_near.y), t_near.z), 0.0f);
+    float t_exit = fmin(fmin(fmin(t_far.x, t_far.y), t_far.z), t_max);
+    return t_enter <= t_exit;
+}
+
+int ray_hits_primitive(
+    Ray* ray,
+    // index of primitive and geometries
+    unsigned int i,
+    GeometryContainer* geometries,
+    // resulting geometry and distance
+    Geometry* geometry, float* t,
+    // globals
+    Globals* globals
+) {
+    // build geometry from primitive
+    BVHPrimitive prim = geometries->prims[i];
+    geometry->data = geometries->data + prim.offset;
+    geometry->type_id = prim.type_id;
+    geometry->index = prim.index;
+    // cast ray to geometry - spheres are read from their structure-of-arrays copy
+#ifdef GEOMETRY_SPHERE_ENABLED
+    if (prim.type_id == GEOMETRY_SPHERE_TYPE_ID) return sphere_cast_stored(ray, geometries, i, t);
+#endif
+    return geometry_cast_ray(ray, geometry, geometries, t, globals);
+}
+
+void ray_cast_to_primitive(
+    Ray* ray,
+    // index of primitive and geometries
+    unsigned int i,
+    GeometryContainer* geometries,
+    // closest geometry, distance and hit
+    Geometry* closest, float* t, int* hit,
+    // globals
+    Globals* globals
+) {
+    // cast ray to geometry
+    Geometry geometry; float t_cur;
+    if (ray_hits_primitive(ray, i, geometries, &geometry, &t_cur, globals)) {
+        // update closest
+        if ((t_cur < *t - EPS) || (!*hit)) { 
+            closest->data = geometry.data;
+            closest->type_id = geometry.type_id;
+            closest->index = geometry.index;
+            *t = t_cur; 
+        }
+        // set hit
+        *hit = 1;
+    }
+}
+
 int ray_cast_to_geometries(
     Ray* ray,
     // geometries
-    Container* geometries,
+    GeometryContainer* geometries,
     // return geometry and distance
     Geometry* closest, float* t,
     // globals
     Globals* globals
 ) {
-    // find closest intersecting geometry
-    Geometry geometry; geometry.data = geometries->data;
-    float t_cur; int hit = 0;
-    // loop throu all geometries
-    for (unsigned int i = 0; i < geometries->n; i++) {
-        // set current geometry type
-        geometry.type_id = geometries->type_ids[i];
-        // cast ray to geometry
-        if (geometry_cast_ray(ray, &geometry, &t_cur, globals)) {
-            // update closest
-            if ((t_cur < *t - EPS) || (!hit)) { 
-                closest->data = geometry.data;
-                closest->type_id = geometry.type_id;
-                *t = t_cur; 
-            }
-            // set hit
-            hit = 1;
-        }
-        // increase pointer to next geometry
-        geometry.data += geometry_get_type_size(geometry.type_id);
+    int hit = 0;
+    // unbounded geometries are tested against every ray
+    for (unsigned int i = 0; i < geometries->n_unbounded; i++)
+        ray_cast_to_primitive(ray, i, geometries, closest, t, &hit, globals);
+    // walk the hierarchy without a stack by following child and skip links
+    float3 inv_dir = 1.0f / ray->direction;
+    unsigned int i = 0;
+    while (i < geometries->n_nodes) {
+        // top levels are stored first and read from local memory
+        BVHNode node = (i < geometries->n_local_nodes)? geometries->local_nodes[i] : geometries->nodes[i];
+        // skip subtree on miss
+        if (!ray_intersects_box(ray, inv_dir, &node, hit? *t : MAXFLOAT)) { i = node.skip; continue; }
+        // descend into inner node
+        if (node.count == 0) { i = node.child; continue; }
+        // test primitives of leaf
+        for (unsigned int k = 0; k < node.count; k++)
+            ray_cast_to_primitive(ray, node.child + k, geometries, closest, t, &hit, globals);
+        i = node.skip;
     }
     return hit;
 }
+
+int ray_occluded(
+    Ray* ray,
+    // geometries
+    GeometryContainer* geometries,
+    // distance to light source
+    float t_max,
+    // globals
+    Globals* globals
+) {
+    // any hit before t_max is enough - no closest geometry is tracked
+    Geometry geometry; float t;
+    for (unsigned int i = 0; i < geometries->n_unbounded; i++)
+        if (ray_hits_primitive(ray, i, geometries, &geometry, &t, globals) && (t <= t_max)) return 1;
+    // same walk as ray_cast_to_geometries but boxes beyond the light are culled from the start
+    float3 inv_dir = 1.0f / ray->direction;
+    unsigned int i = 0;
+    while (i < geometries->n_nodes) {
+        BVHNode node = (i < geometries->n_local_nodes)? geometries->local_nodes[i] : geometries->nodes[i];
+        if (!ray_intersects_box(ray, inv_dir, &node, t_max)) { i = node.skip; continue; }
+        if (node.count == 0) { i = node.child; continue; }
+        // leave at first blocking primitive
+        for (unsigned int k = 0; k < node.count; k++)
+            if (ray_hits_primitive(ray, node.child + k, geometries, &geometry, &t, globals) && (t <= t_max)) return 1;
+        i = node.skip;
+    }
+    return 0;
+}
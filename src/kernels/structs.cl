@@ -18,33 +18,171 @@ typedef struct Ray{
 } Ray;
 
 
-/*** Container ***/
+/*** Bounding Volume Hierarchy ***/
+// keep in sync with include/bvh.hpp
 
-typedef struct Container {
-    // data and type-ids
-    __local float* data;
-    __local unsigned int* type_ids;
+typedef struct BVHNode {
+    // bounding box and index of node to continue with once the subtree is missed or done
+    float bmin[3]; unsigned int skip;
+    // inner: index of first child - leaf: index of first primitive
+    float bmax[3]; unsigned int child;
+    // number of primitives in leaf - zero for inner nodes
+    unsigned int count;
+} BVHNode;
+
+typedef struct BVHPrimitive {
+    // offset of geometry data, its type and id
+    unsigned int offset, type_id, id;
+    // index of primitive within geometry (e.g. triangle of mesh)
+    unsigned int index;
+} BVHPrimitive;
+
+
+/*** Light Sampling ***/
+// keep in sync with include/lightSampler.hpp
+
+typedef struct LightAlias {
+    // probability of keeping this light when its slot is drawn, otherwise alias is taken
+    float prob; unsigned int alias;
+    // probability of drawing this light at all
+    float pdf;
+} LightAlias;
+
+
+/*** Adaptive Sampling ***/
+// keep in sync with include/camera.hpp
+
+typedef struct PixelStats {
+    // samples taken and sum of their squared luminances
+    unsigned int spp; float sum_sq;
+} PixelStats;
+
+
+/*** Address Spaces ***/
+// scene data is copied to local memory unless the host found it too large for the device
+
+#ifdef GEOMETRY_IN_GLOBAL
+#define GEOMETRY_SPACE __global
+#else
+#define GEOMETRY_SPACE __local
+#endif
+
+#ifdef MATERIAL_IN_GLOBAL
+#define MATERIAL_SPACE __global
+#else
+#define MATERIAL_SPACE __local
+#endif
+
+#ifdef LIGHT_IN_GLOBAL
+#define LIGHT_SPACE __global
+#else
+#define LIGHT_SPACE __local
+#endif
+
+// pointer to scene data read in place or after the work-group copied it to local memory
+#define STAGE_GLOBAL(global_ptr, local_ptr, size) (global_ptr)
+#define STAGE_LOCAL(global_ptr, local_ptr, size) (global_to_local((__global char*)(global_ptr), (__local char*)(local_ptr), (size)), (local_ptr))
+
+#ifdef GEOMETRY_IN_GLOBAL
+#define GEOMETRY_STAGE STAGE_GLOBAL
+#else
+#define GEOMETRY_STAGE STAGE_LOCAL
+#endif
+
+#ifdef MATERIAL_IN_GLOBAL
+#define MATERIAL_STAGE STAGE_GLOBAL
+#else
+#define MATERIAL_STAGE STAGE_LOCAL
+#endif
+
+#ifdef LIGHT_IN_GLOBAL
+#define LIGHT_STAGE STAGE_GLOBAL
+#else
+#define LIGHT_STAGE STAGE_LOCAL
+#endif
+
+
+/*** Containers ***/
+
+typedef struct GeometryContainer {
+    // data, type-ids and offset of each element in data
+    GEOMETRY_SPACE float* data;
+    GEOMETRY_SPACE unsigned int* type_ids;
+    GEOMETRY_SPACE unsigned int* offsets;
     // number of elements in container
     unsigned int n;
-} Container;
+    // bounding volume hierarchy
+    __global BVHNode* nodes;
+    __global BVHPrimitive* prims;
+    unsigned int n_nodes, n_unbounded;
+    // shared vertices and indices of triangle meshes
+    __global float* vertices;
+    __global unsigned int* indices;
+    // spheres of bvh primitives as four blocks of centers x, y, z and radii
+    __global float* spheres;
+    unsigned int sphere_stride;
+    // top levels of the hierarchy are stored first - this many of them are copied to local memory
+    __local BVHNode* local_nodes;
+    unsigned int n_local_nodes;
+} GeometryContainer;
+
+typedef struct MaterialContainer {
+    MATERIAL_SPACE float* data;
+    MATERIAL_SPACE unsigned int* type_ids;
+    MATERIAL_SPACE unsigned int* offsets;
+    unsigned int n;
+} MaterialContainer;
+
+typedef struct LightContainer {
+    LIGHT_SPACE float* data;
+    LIGHT_SPACE unsigned int* type_ids;
+    LIGHT_SPACE unsigned int* offsets;
+    unsigned int n;
+    // alias table to pick lights by power
+    __global LightAlias* alias;
+} LightContainer;
+
 
+/*** Compressables ***/
 
-/*** Compressable ***/
+typedef struct Geometry {
+    GEOMETRY_SPACE float* data;
+    unsigned int type_id;
+    // index of primitive within geometry
+    unsigned int index;
+} Geometry;
 
-typedef struct Compressable {
-    __local float* data;
+typedef struct Material {
+    MATERIAL_SPACE float* data;
     unsigned int type_id;
-} Compressable;
+} Material;
+
+typedef struct Light {
+    LIGHT_SPACE float* data;
+    unsigned int type_id;
+} Light;
+
+/*** Wavefront ***/
+
+typedef struct Path {
+    // current ray and ray scattered at its hit
+    Ray ray, scattered;
+    // product of colors along the path
+    float3 throughput;
+    // hit point, normal and attenuation of current ray
+    float3 p, normal, attenuation;
+    // material at hit point
+    unsigned int material_id;
+    // pixel, number of bounces and whether the ray scatters
+    unsigned int pixel, bounce, scatters;
+} Path;
 
-#define Material Compressable
-#define Geometry Compressable
-#define Light Compressable
 
 /*** Globals ***/
 // if changing this struct remember to also adjust the allocated size in host code
 
 typedef struct Globals {
     // values that need to be globally accessable in each work-item but can differ between work-items
-    // random number generator
-    unsigned int seed0, seed1;
+    // counter-based random number generator - key of current stream and numbers drawn from it
+    unsigned int rng_key, rng_counter;
 } Globals;
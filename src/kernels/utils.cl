@@ -3,28 +3,35 @@
 
 /*** random numbers ***/
 
-#define RANDOM_MAX 4294967296
+/* same generator as src/random.cpp so cpu and gpu renders sample the same streams */
 
-float randf(Globals* globals) {
-
-	/* hash the seeds using bitwise AND operations and bitshifts */
-	globals->seed0 = 36969 * ((globals->seed0) & 65535) + ((globals->seed0) >> 16);
-	globals->seed1 = 18000 * ((globals->seed1) & 65535) + ((globals->seed1) >> 16);
-
-	unsigned int ires = ((globals->seed0) << 16) + (globals->seed1);
+unsigned int random_hash(unsigned int v) {
+    /* pcg-rxs-m-xs permutation of one lcg step */
+    unsigned int s = v * 747796405u + 2891336453u;
+    unsigned int word = ((s >> ((s >> 28u) + 4u)) ^ s) * 277803737u;
+    return (word >> 22u) ^ word;
+}
 
-	/* use union struct to convert int to float */
-	union {
-		float f;
-		unsigned int ui;
-	} res;
+void random_seed(Globals* globals, unsigned int seed, unsigned int pixel, unsigned int sample) {
+    /* key of stream depends on all three - numbers are counted from zero */
+    globals->rng_key = random_hash(random_hash(random_hash(seed) + pixel) + sample);
+    globals->rng_counter = 0;
+}
 
-	res.ui = (ires & 0x007fffff) | 0x40000000;  /* bitwise AND, bitwise OR */
-	return (res.f - 2.0f) / 2.0f;
+float randf(Globals* globals) {
+    /* hash key and counter */
+    unsigned int bits = random_hash(globals->rng_key + random_hash(globals->rng_counter++));
+    /* convert upper 23 bits to float in [1, 2) and map to [0, 1) */
+    return as_float((bits >> 9) | 0x3f800000) - 1.0f;
 }
 
 /*** Vector-Operations ***/
 
+float float3_get(float3 v, unsigned int axis) {
+    // component of vector by index
+    return (axis == 0)? v.x : ((axis == 1)? v.y : v.z);
+}
+
 float3 rotate_along_axis(float3 normalized_v, float3 normalized_axis, float theta) {
     // compute sin and cosin
     float c = cos(theta); 
@@ -61,8 +68,8 @@ float3 rand_in_unit_sphere(Globals* globals) {
     );
     // check if v is in unit circle
     if (dot(v, v) < 1) return v;
-    // scale v to be in unit circle
-    float s = 2 * randf(globals) - 1;
+    // scale v to be in unit circle - same as Vec3f::rand_in_unit_sphere so cpu and opencl take the same directions
+    float s = randf(globals);
     return normalize(v) * s;
 }
 
@@ -0,0 +1,293 @@
+#pragma once
+#include "include/_defines.h"
+#include "src/kernels/structs.cl"
+#include "src/kernels/ray.cl"
+#include "src/kernels/material.cl"
+#include "src/kernels/light.cl"
+#include "src/kernels/utils.cl"
+#include "src/kernels/camera.cl"
+
+// Wavefront path tracing - one path per pixel is split into generation, intersection,
+// shading per material type and shadow ray stages connected by compacted queues of path ids
+
+/*** scene arguments ***/
+// shared by intersection, shading and shadow kernels - see Camera::set_scene_args
+
+#define WAVEFRONT_SCENE_PARAMS \
+    __global float* geometry_data, __global unsigned int* geometry_table, unsigned int n_geometries, unsigned int n_geometry_bytes, \
+    __local float* loc_geometry_data, __local unsigned int* loc_geometry_table, \
+    __global float* material_data, __global unsigned int* material_table, unsigned int n_materials, unsigned int n_material_bytes, \
+    __local float* loc_material_data, __local unsigned int* loc_material_table, \
+    __global float* light_data, __global unsigned int* light_table, unsigned int n_lights, unsigned int n_light_bytes, \
+    __local float* loc_light_data, __local unsigned int* loc_light_table, \
+    __global BVHNode* bvh_nodes, __global BVHPrimitive* bvh_prims, unsigned int n_bvh_nodes, unsigned int n_bvh_unbounded, \
+    __global float* mesh_vertices, __global unsigned int* mesh_indices, \
+    __global float* bvh_spheres, unsigned int bvh_sphere_stride, \
+    __local BVHNode* loc_bvh_nodes, unsigned int n_loc_bvh_nodes, \
+    __global LightAlias* light_alias
+
+#define WAVEFRONT_SCENE_ARGS \
+    geometry_data, geometry_table, n_geometries, n_geometry_bytes, loc_geometry_data, loc_geometry_table, \
+    material_data, material_table, n_materials, n_material_bytes, loc_material_data, loc_material_table, \
+    light_data, light_table, n_lights, n_light_bytes, loc_light_data, loc_light_table, \
+    bvh_nodes, bvh_prims, n_bvh_nodes, n_bvh_unbounded, mesh_vertices, mesh_indices, \
+    bvh_spheres, bvh_sphere_stride, loc_bvh_nodes, n_loc_bvh_nodes, light_alias
+
+void wavefront_load_scene(
+    WAVEFRONT_SCENE_PARAMS,
+    // resulting containers
+    GeometryContainer* geometries, MaterialContainer* materials, LightContainer* lights
+) {
+    // read instance tables (type ids followed by data offsets) to local memory unless they stay in global memory
+    GEOMETRY_SPACE unsigned int* geometry_ids = GEOMETRY_STAGE(geometry_table, loc_geometry_table, 2 * n_geometries * sizeof(unsigned int));
+    MATERIAL_SPACE unsigned int* material_ids = MATERIAL_STAGE(material_table, loc_material_table, 2 * n_materials * sizeof(unsigned int));
+    LIGHT_SPACE unsigned int*    light_ids    = LIGHT_STAGE(light_table,       loc_light_table,    2 * n_lights * sizeof(unsigned int));
+    // read data to local memory unless it stays in global memory
+    GEOMETRY_SPACE float* geometry_values = GEOMETRY_STAGE(geometry_data, loc_geometry_data, n_geometry_bytes);
+    MATERIAL_SPACE float* material_values = MATERIAL_STAGE(material_data, loc_material_data, n_material_bytes);
+    LIGHT_SPACE float*    light_values    = LIGHT_STAGE(light_data,       loc_light_data,    n_light_bytes);
+    // read top levels of hierarchy to local memory
+    global_to_local((__global char*)bvh_nodes, (__local char*)loc_bvh_nodes, n_loc_bvh_nodes * sizeof(BVHNode));
+    // create containers
+    *geometries = (GeometryContainer){geometry_values, geometry_ids, geometry_ids + n_geometries, n_geometries, bvh_nodes, bvh_prims, n_bvh_nodes, n_bvh_unbounded, mesh_vertices, mesh_indices, bvh_spheres, bvh_sphere_stride, loc_bvh_nodes, n_loc_bvh_nodes};
+    *materials  = (MaterialContainer){material_values, material_ids, material_ids + n_materials, n_materials};
+    *lights     = (LightContainer){light_values,       light_ids,    light_ids + n_lights,       n_lights, light_alias};
+}
+
+
+/*** helpers ***/
+
+void wavefront_shade(
+    // material type handled by calling kernel
+    unsigned int material_type,
+    // scene
+    MaterialContainer* materials,
+    // paths and queue of paths hitting this material type
+    __global Path* paths,
+    __global unsigned int* material_queues,
+    unsigned int queue_size,
+    // shadow queue and offset of this material type in it
+    __global unsigned int* shadow_queue,
+    unsigned int shadow_offset,
+    // globals
+    __global Globals* all_globals
+) {
+    // get path
+    unsigned int k = get_global_id(0);
+    unsigned int path_id = material_queues[material_type * queue_size + k];
+    Path path = paths[path_id];
+    Globals globals = all_globals[path.pixel];
+    // get material
+    Material material; material_get(path.material_id, materials, &material);
+    // get attenuation and scattered ray
+    path.attenuation = material_get_attenuation(path.p, path.ray.direction, path.normal, &material, &globals);
+    path.scatters = material_get_scatter_ray(path.p, path.ray.direction, path.normal, &material, &path.scattered, &globals);
+    // store path and pass it on to shadow rays
+    paths[path_id] = path;
+    all_globals[path.pixel] = globals;
+    shadow_queue[shadow_offset + k] = path_id;
+}
+
+
+/*** kernels ***/
+
+__kernel void wavefront_get_path_size(__global unsigned int* size) {
+    // size of path struct as laid out by the device
+    *size = sizeof(Path);
+}
+
+__kernel void wavefront_generate(
+    // paths, first ray queue and sum of sample colors
+    __global Path*          paths,
+    __global unsigned int*  queue,
+    __global float*         sample_sum,
+    // globals
+    __global Globals*       all_globals,
+    // image size
+    unsigned int w, unsigned int h,
+    // camera orientation
+    float cam_x, float cam_y, float cam_z,
+    float cam_u, float cam_v, float cam_w,
+    float cam_a, float cam_b, float cam_c,
+    // field of view and current antialiasing sample
+    float cam_fov,
+    unsigned int sample,
+    // seed of random numbers and index of first sample of this frame
+    unsigned int seed,
+    unsigned int first_sample
+) {
+    // one path per pixel
+    unsigned int i = get_global_id(0);
+    unsigned int x = i % w;
+    unsigned int y = i / w;
+    Globals globals = all_globals[i];
+    // each sample draws from its own stream of the pixel
+    random_seed(&globals, seed, i, first_sample + sample);
+    // create camera
+    Camera cam = (Camera) {
+        (float3)(cam_x, cam_y, cam_z),
+        (float3)(cam_u, cam_v, cam_w),
+        (float3)(cam_a, cam_b, cam_c),
+        cam_fov
+    };
+    // first sample goes throu middle of pixel and clears the sample sum
+    Ray ray;
+    if (sample == 0) {
+        camera_get_ray_throu_pixel(&ray, x, y, w, h, cam, &globals);
+        vstore3((float3)(0.0f, 0.0f, 0.0f), i, sample_sum);
+    } else {
+        // get random offset from pixel center
+        float u = 2 * randf(&globals) - 1;
+        float v = 2 * randf(&globals) - 1;
+        camera_get_ray_throu_pixel(&ray, x + u, y + v, w, h, cam, &globals);
+    }
+    // initialize path
+    Path path;
+    path.ray = ray;
+    path.throughput = (float3)(1.0f, 1.0f, 1.0f);
+    path.pixel = i;
+    path.bounce = 0;
+    paths[i] = path;
+    queue[i] = i;
+    // save globals
+    all_globals[i] = globals;
+}
+
+__kernel void wavefront_intersect(
+    WAVEFRONT_SCENE_PARAMS,
+    // paths and queue of active paths
+    __global Path*          paths,
+    __global unsigned int*  queue,
+    // queues per material type and their counters
+    __global unsigned int*  material_queues,
+    unsigned int            queue_size,
+    __global unsigned int*  counters,
+    // sum of sample colors
+    __global float*         sample_sum,
+    // globals
+    __global Globals*       all_globals
+) {
+    GeometryContainer geometries; MaterialContainer materials; LightContainer lights;
+    wavefront_load_scene(WAVEFRONT_SCENE_ARGS, &geometries, &materials, &lights);
+    // get path
+    unsigned int path_id = queue[get_global_id(0)];
+    Path path = paths[path_id];
+    Globals globals = all_globals[path.pixel];
+    // cast ray to all geometries
+    Geometry closest; float t;
+    if (ray_cast_to_geometries(&path.ray, &geometries, &closest, &t, &globals)) {
+        // get intersection point, normal and material
+        path.p = ray_advance(&path.ray, t - EPS);
+        path.normal = geometry_get_normal(path.p, &closest, &geometries, &globals);
+        path.material_id = geometry_get_material_id(&closest);
+        Material material; material_get(path.material_id, &materials, &material);
+        paths[path_id] = path;
+        // sort path into queue of its material type
+        unsigned int k = atomic_inc(counters + 1 + material.type_id);
+        material_queues[material.type_id * queue_size + k] = path_id;
+    } else {
+        // path ends with background color
+        float s = 0.5 * (1.0 - path.ray.direction.z);
+        float3 color = path.throughput * ((1 - s) + (float3)(0.5, 0.7, 1.0) * s);
+        vstore3(vload3(path.pixel, sample_sum) + color, path.pixel, sample_sum);
+    }
+}
+
+__kernel void wavefront_shade_diffuse(
+    WAVEFRONT_SCENE_PARAMS,
+    __global Path* paths, __global unsigned int* material_queues, unsigned int queue_size,
+    __global unsigned int* shadow_queue, unsigned int shadow_offset, __global Globals* all_globals
+) {
+    GeometryContainer geometries; MaterialContainer materials; LightContainer lights;
+    wavefront_load_scene(WAVEFRONT_SCENE_ARGS, &geometries, &materials, &lights);
+    wavefront_shade(MATERIAL_DIFFUSE_TYPE_ID, &materials, paths, material_queues, queue_size, shadow_queue, shadow_offset, all_globals);
+}
+
+__kernel void wavefront_shade_metal(
+    WAVEFRONT_SCENE_PARAMS,
+    __global Path* paths, __global unsigned int* material_queues, unsigned int queue_size,
+    __global unsigned int* shadow_queue, unsigned int shadow_offset, __global Globals* all_globals
+) {
+    GeometryContainer geometries; MaterialContainer materials; LightContainer lights;
+    wavefront_load_scene(WAVEFRONT_SCENE_ARGS, &geometries, &materials, &lights);
+    wavefront_shade(MATERIAL_METAL_TYPE_ID, &materials, paths, material_queues, queue_size, shadow_queue, shadow_offset, all_globals);
+}
+
+__kernel void wavefront_shade_dielectric(
+    WAVEFRONT_SCENE_PARAMS,
+    __global Path* paths, __global unsigned int* material_queues, unsigned int queue_size,
+    __global unsigned int* shadow_queue, unsigned int shadow_offset, __global Globals* all_globals
+) {
+    GeometryContainer geometries; MaterialContainer materials; LightContainer lights;
+    wavefront_load_scene(WAVEFRONT_SCENE_ARGS, &geometries, &materials, &lights);
+    wavefront_shade(MATERIAL_DIELECTRIC_TYPE_ID, &materials, paths, material_queues, queue_size, shadow_queue, shadow_offset, all_globals);
+}
+
+__kernel void wavefront_shadow(
+    WAVEFRONT_SCENE_PARAMS,
+    // paths and queue of shaded paths
+    __global Path*          paths,
+    __global unsigned int*  shadow_queue,
+    // queue of paths continuing with the next bounce and its counter
+    __global unsigned int*  next_queue,
+    __global unsigned int*  counters,
+    // sum of sample colors
+    __global float*         sample_sum,
+    // ambient color
+    float ambient_r, float ambient_g, float ambient_b,
+    // globals
+    __global Globals*       all_globals
+) {
+    GeometryContainer geometries; MaterialContainer materials; LightContainer lights;
+    wavefront_load_scene(WAVEFRONT_SCENE_ARGS, &geometries, &materials, &lights);
+    // get path
+    unsigned int path_id = shadow_queue[get_global_id(0)];
+    Path path = paths[path_id];
+    Globals globals = all_globals[path.pixel];
+    // cast shadow rays to all or sampled lights
+    Material material; material_get(path.material_id, &materials, &material);
+    float3 ambient = (float3)(ambient_r, ambient_g, ambient_b);
+    float3 light_color = light_get_total_light(path.p, path.ray.direction, path.normal, &material, &lights, &geometries, ambient, &globals);
+    // combine colors
+    path.throughput *= clamp(light_color * path.attenuation, 0.0f, 1.0f);
+    // continue with scattered ray or end path
+    if (path.scatters && (path.bounce + 1 < MAX_RECURSION_DEPTH)) {
+        path.ray = path.scattered;
+        path.bounce++;
+        next_queue[atomic_inc(counters)] = path_id;
+    } else vstore3(vload3(path.pixel, sample_sum) + path.throughput, path.pixel, sample_sum);
+    paths[path_id] = path;
+}
+
+__kernel void wavefront_finish(
+    // pixel array (rgba-format)
+    __global unsigned char* pixels,
+    // sum of sample colors and number of samples
+    __global float*         sample_sum,
+    unsigned int            antialiasing_n_samples,
+    // sum of colors of previous frames (rgb-format)
+    __global float*         accum,
+    unsigned int            n_accumulated,
+    // sample statistics of each pixel over the accumulated frames
+    __global PixelStats*    pixel_stats
+) {
+    unsigned int i = get_global_id(0);
+    // average samples of this frame
+    float3 color = vload3(i, sample_sum) / antialiasing_n_samples;
+    // accumulate with previous frames - the first frame overrides old values
+    if (n_accumulated > 0) color += vload3(i, accum);
+    vstore3(color, i, accum);
+    // only count samples - all pixels take the same number so luminances are not needed
+    PixelStats stats = (n_accumulated > 0)? pixel_stats[i] : (PixelStats){ 0, 0.0f };
+    stats.spp += antialiasing_n_samples;
+    pixel_stats[i] = stats;
+    // apply gamma correction on average of all frames
+    color = sqrt(color / (n_accumulated + 1));
+    // clamp color values between 0 and 255
+    color = clamp(color, 0.0f, 1.0f); color *= 255;
+    // apply color to pixel
+    pixels[i*4+0] = color.x;
+    pixels[i*4+1] = color.y;
+    pixels[i*4+2] = color.z;
+    pixels[i*4+3] = 255;
+}
@@ -31,4 +31,6 @@ Vec3f PointLight::light_direction(Vec3f p) const { return (this->get_position()
 // light distance
 float PointLight::light_distance_squarred(Vec3f p) const { return Vec3f::dot(this->get_position() - p, this->get_position() - p); }
 // color at position
-Vec3f PointLight::light_color(Vec3f p) const { return this->get_color(); }
\ No newline at end of file
+Vec3f PointLight::light_color(Vec3f p) const { return this->get_color(); }
+// power - mean of color channels
+float PointLight::power(void) const { Vec3f c = this->get_color(); return (c.x() + c.y() + c.z()) / 3; }
\ No newline at end of file
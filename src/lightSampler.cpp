@@ -0,0 +1,80 @@
+#include "lightSampler.hpp"
+#include "light.hpp"
+#include <algorithm>
+
+using namespace std;
+
+/*** constructors ***/
+
+LightSampler::LightSampler(const MemCompressor* lights): lights(lights), n_built(0), version_built(0), version_(0) {
+    // table is built on first update
+    this->entries_ = new vector<LightAlias>();
+}
+
+
+/*** destructor ***/
+
+LightSampler::~LightSampler(void) {
+    delete this->entries_;
+}
+
+
+/*** build ***/
+
+void LightSampler::build(void) {
+    const vector<Compressable*>* instances = this->lights->get_instances();
+    unsigned int n = instances->size();
+    // power of each light and their sum
+    vector<float> power(n);
+    double total = 0;
+    for (unsigned int i = 0; i < n; i++) {
+        power[i] = max(((Light*)instances->at(i))->power(), 0.0f);
+        total += power[i];
+    }
+    // without any power all lights are equally likely
+    if (total <= 0) { fill(power.begin(), power.end(), 1.0f); total = n; }
+    // scale to mean one and split into slots below and above the mean
+    this->entries_->resize(n);
+    vector<double> scaled(n);
+    vector<unsigned int> small, large;
+    for (unsigned int i = 0; i < n; i++) {
+        scaled[i] = power[i] * n / total;
+        this->entries_->at(i).pdf = (float)(power[i] / total);
+        if (scaled[i] < 1.0) small.push_back(i); else large.push_back(i);
+    }
+    // fill each small slot with its light and the rest with a large one
+    while (!small.empty() && !large.empty()) {
+        unsigned int s = small.back(), l = large.back(); small.pop_back();
+        this->entries_->at(s).prob = (float)scaled[s];
+        this->entries_->at(s).alias = l;
+        // remove the part given away from the large light
+        scaled[l] = (scaled[l] + scaled[s]) - 1.0;
+        if (scaled[l] < 1.0) { large.pop_back(); small.push_back(l); }
+    }
+    // remaining slots are full up to rounding
+    for (unsigned int i : large) { this->entries_->at(i).prob = 1.0f; this->entries_->at(i).alias = i; }
+    for (unsigned int i : small) { this->entries_->at(i).prob = 1.0f; this->entries_->at(i).alias = i; }
+    // remember state
+    this->n_built = n;
+    this->version_built = this->lights->version();
+    this->version_++;
+}
+
+void LightSampler::update(void) {
+    // colors and positions change the power, added lights the size of the table
+    if ((this->n_built != this->lights->n_instances()) || (this->version_built != this->lights->version())) this->build();
+}
+
+
+/*** sample ***/
+
+unsigned int LightSampler::sample(float u, float* pdf) const {
+    // integer part picks the slot, fraction decides between its light and the alias
+    unsigned int n = this->entries_->size();
+    float x = u * n;
+    unsigned int k = min((unsigned int)x, n - 1);
+    const LightAlias& e = this->entries_->at(k);
+    unsigned int i = ((x - k) < e.prob)? k : e.alias;
+    *pdf = this->entries_->at(i).pdf;
+    return i;
+}
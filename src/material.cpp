@@ -1,4 +1,5 @@
 #include "material.hpp"
+#include "random.hpp"
 #include "math.h"
 
 /*** Color Material ***/
@@ -119,7 +120,7 @@ bool DielectricMaterial::scatter(Vec3f p, Vec3f v, Vec3f n, pair<Vec3f, Vec3f>*
         // approximate reflection probability
         float ref_prob = schlick_approximation(cosine, this->ior());
         // update valid based on probability
-        valid = ((float)rand() / RAND_MAX) > ref_prob;
+        valid = randf() > ref_prob;
     }
     // either refract of reflect
     ray->second = valid? refracted : (v.reflect(n) * -1);
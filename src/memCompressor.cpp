@@ -1,5 +1,6 @@
 #include "memCompressor.hpp"
 #include <memory>
+#include <algorithm>
 
 using namespace std;
 
@@ -13,42 +14,252 @@ class OutOfBoundsException : public exception {
 Compressable::Compressable(void) {}
 // setters
 void Compressable::id(unsigned int id) { this->id_ = id; }
+void Compressable::offset(unsigned int offset) { this->offset_ = offset; }
 void Compressable::data(float* data) { this->data_ = data; }
+void Compressable::compressor(MemCompressor* compressor) { this->compressor_ = compressor; }
 
 const float Compressable::read(unsigned int i) const {
     // check if i is in range
     if (i >= this->get_size()) throw OutOfBoundsException();
-    // read and return value at index
-    return this->data_[i];
+    // read and return value at index - renderers read the snapshot they pinned, everyone else the memory
+    const float* pinned = this->compressor_->data();
+    return (pinned != nullptr)? pinned[this->offset_ + i] : this->data_[i];
 }
 
 void Compressable::write(unsigned int i, float v) {
     // check if i is in range
     if (i >= this->get_size()) throw OutOfBoundsException();
+    // notify compressor about changed data - fails outside of edits
+    if (this->compressor_ != nullptr) this->compressor_->touch(this->id_);
     // write new value at index
     this->data_[i] = v;
 }
 
 
+/*** Renderer Reads ***/
+
+thread_local unsigned int RendererReads::depth_ = 0;
+
+
+/*** Instance Pool ***/
+
+InstancePool::InstancePool(void): used_(0), block_size_(0) {
+    // create vector - the first allocation creates a block
+    this->blocks_ = new vector<char*>();
+}
+
+InstancePool::~InstancePool(void) {
+    // free blocks
+    for (char* block : *this->blocks_) { delete[] block; }
+    delete this->blocks_;
+}
+
+void* InstancePool::allocate(size_t bytes) {
+    // keep every instance aligned for any type
+    bytes = (bytes + alignof(max_align_t) - 1) / alignof(max_align_t) * alignof(max_align_t);
+    this->reserve(bytes);
+    void* p = this->blocks_->back() + this->used_;
+    this->used_ += bytes;
+    return p;
+}
+
+void InstancePool::reserve(size_t bytes) {
+    // current block has enough room left
+    if ((!this->blocks_->empty()) && (this->used_ + bytes <= this->block_size_)) return;
+    // start a new block - the rest of the current one stays unused
+    this->block_size_ = max(bytes, (size_t)INSTANCE_POOL_BLOCK_SIZE);
+    this->blocks_->push_back(new char[this->block_size_]);
+    this->used_ = 0;
+}
+
+
 /*** Memory Compressor ***/
 
-MemCompressor::MemCompressor(unsigned int mem_size): memory_size_(mem_size), filled_(0) {
-    // allocate memory
-    this->memory_ = new float[this->memory_size_];
-    // create vectors
+MemCompressor::MemCompressor(unsigned int chunk_size):
+    memory_size_(0), filled_(0), version_(0), published_(nullptr), epoch_(1), reader_epoch_(0), pinned_(nullptr)
+{
+    // create vectors and pool
+    this->chunks_ = new vector<MemoryChunk>();
     this->instances_ = new vector<Compressable*>();
     this->type_ids_ = new vector<unsigned int>();
-    // set memory tail
-    this->memory_tail_ = this->memory_;
+    this->offsets_ = new vector<unsigned int>();
+    this->sizes_ = new vector<unsigned int>();
+    this->changed_ = new vector<unsigned int>();
+    this->retired_ = new vector<CompressorSnapshot*>();
+    this->pool_ = new InstancePool();
+    // allocate first chunk
+    this->reserve(max(chunk_size, 1u), 0, 0);
+    // renderers always find a snapshot to pin
+    this->publish();
 }
 
 MemCompressor::~MemCompressor(void) {
-    // free memory
-    delete[] this->memory_;
-    // delete all instances
-    for (Compressable* e : *this->instances_) { delete e; }
+    // free memory and all snapshots
+    for (MemoryChunk& c : *this->chunks_) { delete[] c.memory; }
+    this->retired_->push_back(this->published_.load());
+    for (CompressorSnapshot* s : *this->retired_) { delete[] s->memory; delete s; }
+    delete this->chunks_;
+    delete this->retired_;
+    // destroy all instances before their pool
+    for (Compressable* e : *this->instances_) { e->~Compressable(); }
+    delete this->pool_;
     // delete vectors
     delete this->instances_;
     delete this->type_ids_;
+    delete this->offsets_;
+    delete this->sizes_;
+    delete this->changed_;
+}
+
+const CompressorSnapshot* MemCompressor::snapshot(void) const {
+    // editors and other threads always see the memory
+    return RendererReads::active()? this->pinned_.load(memory_order_acquire) : nullptr;
+}
+
+const float* MemCompressor::data(void) const {
+    const CompressorSnapshot* pinned = this->snapshot();
+    return (pinned != nullptr)? pinned->memory : nullptr;
+}
+
+unsigned int MemCompressor::filled(void) const {
+    const CompressorSnapshot* pinned = this->snapshot();
+    return (pinned != nullptr)? pinned->size : this->filled_;
+}
+
+unsigned int MemCompressor::size(void) const {
+    const CompressorSnapshot* pinned = this->snapshot();
+    return (pinned != nullptr)? pinned->capacity : this->memory_size_;
+}
+
+const vector<Compressable*>* MemCompressor::get_instances(void) const {
+    // renderers only walk the instances of their snapshot - editors may add more meanwhile
+    const CompressorSnapshot* pinned = this->snapshot();
+    return (pinned != nullptr)? &pinned->instances : this->instances_;
+}
+
+const vector<unsigned int>* MemCompressor::get_type_ids(void) const {
+    const CompressorSnapshot* pinned = this->snapshot();
+    return (pinned != nullptr)? &pinned->type_ids : this->type_ids_;
+}
+
+const vector<unsigned int>* MemCompressor::get_offsets(void) const {
+    const CompressorSnapshot* pinned = this->snapshot();
+    return (pinned != nullptr)? &pinned->offsets : this->offsets_;
+}
+
+unsigned int MemCompressor::version(void) const {
+    // renderers see the version of their snapshot
+    const CompressorSnapshot* pinned = this->snapshot();
+    return (pinned != nullptr)? pinned->version : this->version_;
+}
+
+void MemCompressor::touch(unsigned int id) {
+    // renderers only see complete edits
+    if (!this->editing()) throw EditRequiredException();
+    // new version of data
+    this->version_++;
+    // remember which instance caused it
+    this->changed_->at(id) = this->version_;
+}
+
+void MemCompressor::changed_ranges(unsigned int version, vector<pair<unsigned int, unsigned int>>* ranges) const {
+    // versions and tables of the pinned snapshot on renderer threads
+    const CompressorSnapshot* pinned = this->snapshot();
+    const vector<unsigned int>& changed = (pinned != nullptr)? pinned->changed : *this->changed_;
+    const vector<unsigned int>& offsets = (pinned != nullptr)? pinned->offsets : *this->offsets_;
+    const vector<unsigned int>& sizes = (pinned != nullptr)? pinned->sizes : *this->sizes_;
+    // instances are stored consecutively so changed neighbours merge into one range
+    for (unsigned int i = 0; i < changed.size(); i++) {
+        if (changed[i] <= version) continue;
+        unsigned int offset = offsets[i], size = sizes[i];
+        // extend previous range or start a new one
+        if ((!ranges->empty()) && (ranges->back().first + ranges->back().second == offset))
+            ranges->back().second += size;
+        else ranges->push_back(make_pair(offset, size));
+    }
+}
+
+bool MemCompressor::publish(void) {
+    // nothing changed since the latest snapshot
+    CompressorSnapshot* latest = this->published_.load();
+    if ((latest != nullptr) && (latest->version == this->version_)) return false;
+    // copy filled part of all chunks to a new contiguous snapshot
+    CompressorSnapshot* snapshot = new CompressorSnapshot();
+    snapshot->size = this->filled_;
+    snapshot->memory = new float[max(snapshot->size, 1u)];
+    for (const MemoryChunk& c : *this->chunks_) {
+        if (c.offset >= this->filled_) break;
+        copy(c.memory, c.memory + min(c.size, this->filled_ - c.offset), snapshot->memory + c.offset);
+    }
+    snapshot->capacity = this->memory_size_;
+    snapshot->version = this->version_;
+    snapshot->changed = *this->changed_;
+    snapshot->instances = *this->instances_;
+    snapshot->type_ids = *this->type_ids_;
+    snapshot->offsets = *this->offsets_;
+    snapshot->sizes = *this->sizes_;
+    snapshot->retired = 0;
+    // replace latest snapshot - the renderer may still read the old one until it pins again
+    CompressorSnapshot* old = this->published_.exchange(snapshot);
+    if (old != nullptr) {
+        old->retired = this->epoch_.fetch_add(1) + 1;
+        this->retired_->push_back(old);
+    }
+    this->reclaim();
+    return true;
+}
+
+void MemCompressor::begin_edit(void) {
+    // writes of the calling thread are accepted from now on
+    this->editor_.store(this_thread::get_id());
+}
+
+void MemCompressor::end_edit(void) {
+    // renderers see all writes of the edit with their next pin
+    this->publish();
+    this->editor_.store(thread::id());
+}
+
+void MemCompressor::reclaim(void) {
+    // a renderer that announced an epoch at or after the retirement pinned a newer snapshot
+    unsigned int reader = this->reader_epoch_.load();
+    vector<CompressorSnapshot*>::iterator kept = this->retired_->begin();
+    for (CompressorSnapshot* s : *this->retired_) {
+        if ((reader == 0) || (reader >= s->retired)) { delete[] s->memory; delete s; }
+        else *(kept++) = s;
+    }
+    this->retired_->erase(kept, this->retired_->end());
+}
+
+void MemCompressor::pin(void) {
+    // announce epoch before loading the snapshot so writers keep it alive
+    this->reader_epoch_.store(this->epoch_.load());
+    this->pinned_.store(this->published_.load());
+}
+
+void MemCompressor::unpin(void) {
+    // reads see the memory again and writers may free the snapshot
+    this->pinned_.store(nullptr);
+    this->reader_epoch_.store(0);
+}
+
+void MemCompressor::reserve(unsigned int n_floats, unsigned int n_instances, size_t n_bytes) {
+    // room for vectors and objects of instances
+    this->instances_->reserve(this->instances_->size() + n_instances);
+    this->type_ids_->reserve(this->type_ids_->size() + n_instances);
+    this->offsets_->reserve(this->offsets_->size() + n_instances);
+    this->sizes_->reserve(this->sizes_->size() + n_instances);
+    this->changed_->reserve(this->changed_->size() + n_instances);
+    this->pool_->reserve(n_bytes + n_instances * alignof(max_align_t));
+    // last chunk has enough room left
+    if (this->filled_ + n_floats <= this->memory_size_) return;
+    // instances never span chunks - the rest of the last chunk stays unused
+    this->filled_ = this->memory_size_;
+    // at least double the capacity so the number of chunks stays small
+    unsigned int size = max(n_floats, this->memory_size_);
+    MemoryChunk chunk = { new float[size](), this->memory_size_, size };
+    this->chunks_->push_back(chunk);
+    this->memory_tail_ = chunk.memory;
+    this->memory_size_ += size;
 }
 
@@ -0,0 +1,139 @@
+// external
+#include "CL/cl2.hpp"
+// internal
+#include "programCache.hpp"
+// standard
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+#include <iterator>
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <stdint.h>
+
+using namespace std;
+
+/*** helpers ***/
+
+static uint64_t fnv1a(const string& data, uint64_t hash = 14695981039346656037ull) {
+    // 64 bit fnv-1a
+    for (unsigned char c : data) { hash ^= c; hash *= 1099511628211ull; }
+    return hash;
+}
+
+static string to_hex(uint64_t v) {
+    ostringstream s; s << hex << v;
+    return s.str();
+}
+
+static void hash_sources(const string& source, uint64_t* hash, vector<string>* seen) {
+    *hash = fnv1a(source, *hash);
+    // follow includes - the compiler resolves them relative to the working directory as well
+    istringstream lines(source);
+    string line;
+    while (getline(lines, line)) {
+        size_t p = line.find("#include \"");
+        if (p == string::npos) continue;
+        size_t begin = p + 10, end = line.find('"', begin);
+        if (end == string::npos) continue;
+        string path = line.substr(begin, end - begin);
+        // each file counts once
+        if (find(seen->begin(), seen->end(), path) != seen->end()) continue;
+        seen->push_back(path);
+        ifstream file(path);
+        hash_sources(string(istreambuf_iterator<char>(file), istreambuf_iterator<char>()), hash, seen);
+    }
+}
+
+
+/*** cache ***/
+
+string cache_path(const string& key, const char* extension) {
+    // file name is a hash of the key
+    return string(PROGRAM_CACHE_DIR) + "/" + to_hex(fnv1a(key)) + extension;
+}
+
+bool read_cache_file(const string& path, const string& key, string* data) {
+    ifstream file(path, ios::binary | ios::ate);
+    if (!file) return false;
+    // size of file bounds the stored key size so a corrupt header cannot cause a huge allocation
+    streamoff size = file.tellg();
+    file.seekg(0);
+    uint32_t key_size = 0;
+    if ((size < (streamoff)sizeof(key_size)) || !file.read((char*)&key_size, sizeof(key_size))) return false;
+    if ((key_size != key.size()) || ((streamoff)key_size > size - (streamoff)sizeof(key_size))) return false;
+    // cached file starts with its full key to rule out hash collisions
+    string stored(key_size, '\0');
+    if (!file.read(&stored[0], key_size) || (stored != key)) return false;
+    // data fills the rest of the file
+    data->assign(istreambuf_iterator<char>(file), istreambuf_iterator<char>());
+    return true;
+}
+
+void write_cache_file(const string& path, const string& key, const char* data, size_t size) {
+    // caching is optional so failing to write is not an error
+    error_code ec;
+    filesystem::create_directories(PROGRAM_CACHE_DIR, ec);
+    // temporary name is unique per writer so concurrent processes do not mix their files
+    random_device random;
+    string temp = path + "." + to_hex(((uint64_t)random() << 32) | random()) + ".tmp";
+    {
+        ofstream file(temp, ios::binary);
+        if (!file) return;
+        uint32_t key_size = key.size();
+        file.write((const char*)&key_size, sizeof(key_size));
+        file.write(key.data(), key_size);
+        file.write(data, size);
+        file.close();
+        if (!file) { filesystem::remove(temp, ec); return; }
+    }
+    // rename replaces an existing file at once
+    filesystem::rename(temp, path, ec);
+    if (ec) filesystem::remove(temp, ec);
+}
+
+static cl::Program* load_binary(const cl::Context& context, const cl::Device& device, const string& path, const string& key, const string& options) {
+    string data;
+    if (!read_cache_file(path, key, &data)) return nullptr;
+    vector<unsigned char> binary(data.begin(), data.end());
+    // create and build program from binary
+    vector<cl_int> status; cl_int err;
+    cl::Program* program = new cl::Program(context, { device }, cl::Program::Binaries{ binary }, &status, &err);
+    if ((err == CL_SUCCESS) && (program->build({ device }, options.c_str()) == CL_SUCCESS)) return program;
+    // driver rejected binary
+    delete program;
+    return nullptr;
+}
+
+static void store_binary(const cl::Program& program, const string& path, const string& key) {
+    // binary of the only device of the program
+    vector<vector<unsigned char>> binaries = program.getInfo<CL_PROGRAM_BINARIES>();
+    if (binaries.empty() || binaries[0].empty()) return;
+    write_cache_file(path, key, (const char*)binaries[0].data(), binaries[0].size());
+}
+
+cl::Program* build_program(const cl::Context& context, const cl::Device& device, const string& source, const string& options) {
+    // key of program
+    uint64_t source_hash = fnv1a("");
+    vector<string> seen;
+    hash_sources(source, &source_hash, &seen);
+    string key = device.getInfo<CL_DEVICE_NAME>() + "\n" + device.getInfo<CL_DRIVER_VERSION>() + "\n" + options + "\n" + to_hex(source_hash);
+    string path = cache_path(key, ".bin");
+    // try cached binary first
+    cl::Program* program = load_binary(context, device, path, key, options);
+    if (program != nullptr) { cout << "Loaded cached program (" << options << ")" << endl; return program; }
+    // build from source
+    program = new cl::Program(context, cl::Program::Sources{ source });
+    if (program->build({ device }, options.c_str()) != CL_BUILD_SUCCESS) {
+        // show build log
+        cout << program->getBuildInfo<CL_PROGRAM_BUILD_LOG>(device) << endl;
+        delete program;
+        throw ProgramBuildFailed();
+    }
+    cout << "Program build successful (" << options << ")" << endl;
+    // add to cache
+    store_binary(*program, path, key);
+    return program;
+}
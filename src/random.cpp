@@ -0,0 +1,39 @@
+#include "random.hpp"
+
+/*** thread-local state ***/
+
+// each thread owns its stream so no generator state is shared
+static thread_local RandomState state = { 0, 0 };
+
+
+/*** random numbers ***/
+
+unsigned int random_hash(unsigned int v) {
+    // pcg-rxs-m-xs permutation of one lcg step
+    unsigned int s = v * 747796405u + 2891336453u;
+    unsigned int word = ((s >> ((s >> 28u) + 4u)) ^ s) * 277803737u;
+    return (word >> 22u) ^ word;
+}
+
+void seed_random(unsigned int seed, unsigned int pixel, unsigned int sample) {
+    // key of stream depends on all three - numbers are counted from zero
+    state.key = random_hash(random_hash(random_hash(seed) + pixel) + sample);
+    state.counter = 0;
+}
+
+RandomState random_state(void) { return state; }
+
+void random_state(RandomState s) { state = s; }
+
+float randf(void) {
+    // hash key and counter
+    unsigned int bits = random_hash(state.key + random_hash(state.counter++));
+    // use union to convert upper 23 bits to float in [1, 2)
+    union {
+        float f;
+        unsigned int ui;
+    } res;
+    res.ui = (bits >> 9) | 0x3f800000;
+    // map to [0, 1)
+    return res.f - 1.0f;
+}
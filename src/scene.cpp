@@ -1,9 +1,12 @@
 // internal
-#include "Scene.hpp"
-#include "Camera.hpp"
+#include "scene.hpp"
+#include "camera.hpp"
 #include "geometry.hpp"
 #include "material.hpp"
 #include "light.hpp"
+#include "bvh.hpp"
+#include "lightSampler.hpp"
+#include "random.hpp"
 // standard
 #include <tuple>
 #include <iostream>
@@ -21,10 +24,16 @@ unsigned int Scene::global_id = 0;
 Scene::Scene(void): id(Scene::global_id) {
     // increase global id
     Scene::global_id++;
-    // create compressors for matrials and geometries
-    this->materialCompressor = new MemCompressor(100);
-    this->geometryCompressor = new MemCompressor(100);
-    this->lightCompressor = new MemCompressor(100);
+    // create compressors for matrials and geometries - they grow with the scene
+    this->materialCompressor = new MemCompressor();
+    this->geometryCompressor = new MemCompressor();
+    this->lightCompressor = new MemCompressor();
+    // create shared buffer for triangle meshes
+    this->meshBuffer = new MeshBuffer();
+    // create bounding volume hierarchy over geometries
+    this->bvh = new BVH(this->geometryCompressor);
+    // create alias table over lights
+    this->lightSampler = new LightSampler(this->lightCompressor);
     // create vector to store cameras
     this->cams = new vector<Camera*>();
     // log
@@ -35,10 +44,13 @@ Scene::Scene(void): id(Scene::global_id) {
 /*** destructor ***/
 
 Scene::~Scene(void) {
-    // delete compressors
+    // delete bvh, light sampler and compressors
+    delete this->bvh;
+    delete this->lightSampler;
     delete this->materialCompressor;
     delete this->geometryCompressor;
     delete this->lightCompressor;
+    delete this->meshBuffer;
     // delete all instances in vectors
     for (Camera* cam : *this->cams) { delete cam; }
     // delete vectors
@@ -50,7 +62,61 @@ Scene::~Scene(void) {
 
 /*** public methods ***/
 
-void Scene::ambient(Vec3f ambient) { this->ambient_color = ambient; }
+void Scene::ambient(Vec3f ambient) {
+    // renderers see the new ambient light with the next published edit
+    if (!this->materialCompressor->editing()) throw EditRequiredException();
+    this->settings.ambient_color = ambient;
+    this->settings.version++;
+}
+
+Vec3f Scene::ambient(void) const {
+    return RendererReads::active()? this->pinned_settings.ambient_color : this->settings.ambient_color;
+}
+
+void Scene::begin_edit(void) {
+    // wait for other editors - the thread holding the lock may nest edits
+    this->edit_lock.lock();
+    if (this->edit_depth++ > 0) return;
+    // compressors accept writes of this thread only
+    this->materialCompressor->begin_edit();
+    this->geometryCompressor->begin_edit();
+    this->lightCompressor->begin_edit();
+}
+
+void Scene::end_edit(void) {
+    // all writes of the outermost edit become visible to the next frame together
+    if (--this->edit_depth == 0) {
+        this->materialCompressor->end_edit();
+        this->geometryCompressor->end_edit();
+        this->lightCompressor->end_edit();
+        lock_guard<mutex> lock(this->settings_lock);
+        this->published_settings = this->settings;
+    }
+    this->edit_lock.unlock();
+}
+
+void Scene::pin(void) const {
+    // frame reads the latest snapshots while editors keep writing
+    {
+        lock_guard<mutex> lock(this->settings_lock);
+        this->pinned_settings = this->published_settings;
+    }
+    this->materialCompressor->pin();
+    this->geometryCompressor->pin();
+    this->lightCompressor->pin();
+}
+
+void Scene::unpin(void) const {
+    this->materialCompressor->unpin();
+    this->geometryCompressor->unpin();
+    this->lightCompressor->unpin();
+}
+
+unsigned int Scene::version(void) const {
+    // all versions only increase so their sum changes with every write
+    unsigned int version = RendererReads::active()? this->pinned_settings.version : this->settings.version;
+    return version + this->materialCompressor->version() + this->geometryCompressor->version() + this->lightCompressor->version();
+}
 
 unsigned int Scene::addCamera(void) {
     // create camera object
@@ -71,47 +137,60 @@ void Scene::activateCamera(unsigned int cam_id) {
     cout << "Activated camera " << cam_id << " in scene " << this->id << endl;
 }
 
-bool Scene::cast(const Vec3f origin, const Vec3f dir, Geometry** geometry, float* t) const {
+template<> unsigned int Scene::addGeometry<TriangleMesh>(Config* conf) {
+    // move triangles into shared mesh buffer
+    TriangleMeshConfig* conf_ = (TriangleMeshConfig*)conf;
+    conf_->buffer = this->meshBuffer;
+    conf_->first_triangle = this->meshBuffer->add(&conf_->vertices, &conf_->indices);
+    // create mesh geometry
+    return this->add<TriangleMesh>(this->geometryCompressor, conf);
+}
 
-    bool hit = false;
-    *t = numeric_limits<float>::max();
+bool Scene::cast(const Vec3f origin, const Vec3f dir, Geometry** geometry, unsigned int* index, float* t) const {
     // find intersection closest to origin
-    for (Compressable* e : *this->geometryCompressor->get_instances()) {
-        // convert compressable to geometry
-        Geometry* geo = (Geometry*)e;
-        // cast intersection with geometry
-        float t_;
-        if (geo->cast(origin, dir, &t_)) { 
-            // and check if geometry is closer
-            if (t_ < *t) { hit = true; *t = t_; *geometry = geo; }
+    return this->bvh->cast(origin, dir, geometry, index, t);
+}
+
+bool Scene::occluded(const Vec3f origin, const Vec3f dir, float t_max) const {
+    // stop at first hit before t_max
+    return this->bvh->occluded(origin, dir, t_max);
+}
+
+Float8 Scene::cast_packet(const Vec3f8& origin, const Vec3f8& dir, Float8 active, Geometry** geometry, unsigned int* index, Float8* t) const {
+    // find intersections closest to origins of all lanes
+    return this->bvh->cast_packet(origin, dir, active, geometry, index, t);
+}
+
+Vec3f Scene::light_contribution(Light* l, Vec3f p, Vec3f vision_dir, Vec3f normal, Material* material) const {
+    // create ray toward light
+    Vec3f light_dir = l->light_direction(p);
+    float distance = l->light_distance_squarred(p);
+    // check if light ray is below 90 degrees
+    if (Vec3f::dot(light_dir, normal) <= EPS) return Vec3f(0, 0, 0);
+    // check for objects between point and light
+    if (this->occluded(p, light_dir, sqrtf(distance))) return Vec3f(0, 0, 0);
+    // reflect light ray
+    Vec3f light_reflect = light_dir.reflect(normal);
+    // phong reflection model
+    float diffuse = Vec3f::dot(light_dir, normal) * material->diffuse(p);
+    float specular = pow(-Vec3f::dot(light_reflect, vision_dir) * material->specular(p), material->shininess(p));
+    return l->light_color(p) * (diffuse + specular);
+}
+
+Vec3f Scene::light_color(Vec3f p, Vec3f vision_dir, Vec3f normal, Material* material, unsigned int n_samples) const {
+    Vec3f light_color = this->ambient(); 
+    unsigned int n_lights = this->lightCompressor->n_instances();
+    // check all lights unless sampling is cheaper
+    if ((n_samples == 0) || (n_samples >= n_lights)) {
+        for (Compressable* e : *this->get_light_compressor()->get_instances()) {
+            light_color = light_color + this->light_contribution((Light*)e, p, vision_dir, normal, material);
         }
+        return light_color;
     }
-    // return hit
-    return hit;
-}
-
-Vec3f Scene::light_color(Vec3f p, Vec3f vision_dir, Vec3f normal, Material* material) const {
-    Vec3f light_color = Vec3f(this->ambient_color); 
-    // check for light
-    for (Compressable* e : *this->get_light_compressor()->get_instances()) {
-        // convert to light
-        Light* l = (Light*)e;
-        // create ray toward light
-        Vec3f light_dir = l->light_direction(p);
-        float distance = l->light_distance_squarred(p);
-        // check if light ray is below 90 degrees
-        if (Vec3f::dot(light_dir, normal) <= EPS) continue;
-        // on no intersection
-        float t; Geometry* tmp;
-        if ( (!this->cast(p, light_dir, &tmp, &t)) || (t*t > distance) ) { 
-            // reflect light ray
-            Vec3f light_reflect = light_dir.reflect(normal);
-            // phong reflection model
-            float diffuse = Vec3f::dot(light_dir, normal) * material->diffuse(p);
-            float specular = pow(-Vec3f::dot(light_reflect, vision_dir) * material->specular(p), material->shininess(p));
-            // add all together
-            light_color = light_color + l->light_color(p) * (diffuse + specular);
-        }
+    // pick lights by power - dividing by the probability of each pick keeps the mean of all lights
+    for (unsigned int s = 0; s < n_samples; s++) {
+        float pdf; unsigned int i = this->lightSampler->sample(randf(), &pdf);
+        light_color = light_color + this->light_contribution(this->get_light(i), p, vision_dir, normal, material) * (1.0f / (n_samples * pdf));
     }
     return light_color;
 }
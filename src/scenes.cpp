@@ -0,0 +1,173 @@
+// internal
+#include "scenes.hpp"
+#include "vec3f.hpp"
+#include "scene.hpp"
+#include "camera.hpp"
+#include "geometry.hpp"
+#include "material.hpp"
+#include "light.hpp"
+// standard
+#include <vector>
+#include <cstring>
+#include <math.h>
+
+using namespace std;
+
+/*** scenes ***/
+
+void dielectric_scene(Scene* scene) {
+    // set up everything in one edit
+    scene->begin_edit();
+    // scene ambient light
+    scene->ambient(Vec3f(1.0, 1.0, 1.0));
+    // set up camera
+    unsigned int main_cam_id = scene->addCamera();
+    scene->activateCamera(main_cam_id);
+    scene->get_active_camera()->transform(Vec3f(0, 0, 0), Vec3f(0, 1, 0), Vec3f(0, 0, 1));
+    scene->get_active_camera()->FOV(235);
+    
+    // add lights
+    scene->addLight<PointLight>(new PointLightConfig(0.3, 0, -0.4, 0.5, 0.5, 0.5));
+    scene->addLight<PointLight>(new PointLightConfig(-0.3, 0, -0.4, 0.5, 0.5, 0.5));
+
+    // add materials
+    unsigned int diffA = scene->addMaterial<DiffuseMaterial>(new DiffuseMaterialConfig(0.8, 0.3, 0.3, 1, 0, 0));
+    unsigned int diffB = scene->addMaterial<DiffuseMaterial>(new DiffuseMaterialConfig(0.8, 0.9, 1.0, 1, 0, 0));
+    unsigned int metal = scene->addMaterial<MetalMaterial>(new MetalMaterialConfig(0.8, 0.6, 0.2, 1, 1, 100, 0.3));
+    unsigned int dielec = scene->addMaterial<DielectricMaterial>(new DielectricMaterialConfig(1, 1, 100, 1.5f));
+    // add geometries
+    unsigned int ground = scene->addGeometry<Sphere>(new SphereConfig(Vec3f(0, 0, 100000.5), 100000));
+    unsigned int left = scene->addGeometry<Sphere>(new SphereConfig(Vec3f(0.7, 1.2, 0), 0.5));
+    unsigned int middle = scene->addGeometry<Sphere>(new SphereConfig(Vec3f(0, 0.8, 0), 0.5));
+    unsigned int inner = scene->addGeometry<Sphere>(new SphereConfig(Vec3f(0, 0.8, 0), -0.49));
+    unsigned int right = scene->addGeometry<Sphere>(new SphereConfig(Vec3f(-0.7, 1.2, 0), 0.5));
+    // assign materials to geometries
+    scene->get_geometry(ground)->assign_material(diffB);
+    scene->get_geometry(left)->assign_material(diffA);
+    scene->get_geometry(middle)->assign_material(dielec);
+    scene->get_geometry(inner)->assign_material(dielec);
+    scene->get_geometry(right)->assign_material(metal);
+    scene->end_edit();
+}
+
+void cornell_scene(Scene* scene) {
+    // set up everything in one edit
+    scene->begin_edit();
+    // scene ambient light
+    scene->ambient(Vec3f(0.8, 0.8, 0.8));
+    // set up camera
+    unsigned int main_cam_id = scene->addCamera();
+    scene->activateCamera(main_cam_id);
+    scene->get_active_camera()->transform(Vec3f(0, -3, 0), Vec3f(0, 1, 0), Vec3f(0, 0, 1));
+    scene->get_active_camera()->FOV(90);
+    
+    // build box
+    // add materials
+    unsigned int white = scene->addMaterial<DiffuseMaterial>(new DiffuseMaterialConfig(0.9, 0.9, 0.9, 0.3, 0.7, 3));
+    unsigned int red = scene->addMaterial<DiffuseMaterial>(new DiffuseMaterialConfig(0.9, 0, 0, 0.3, 0.7, 3));
+    unsigned int blue = scene->addMaterial<DiffuseMaterial>(new DiffuseMaterialConfig(0, 0, 0.9, 0.3, 0.7, 3));
+    // box geometries
+    unsigned int top    = scene->addGeometry<Plane>(new PlaneConfig(Vec3f(0, 0, -3), Vec3f(0, 0, 1)));
+    unsigned int bottom = scene->addGeometry<Plane>(new PlaneConfig(Vec3f(0, 0, 3), Vec3f(0, 0, -1)));
+    unsigned int back   = scene->addGeometry<Plane>(new PlaneConfig(Vec3f(0, 6, 0), Vec3f(0, -1, 0)));
+    unsigned int left   = scene->addGeometry<Plane>(new PlaneConfig(Vec3f(4, 0, 0), Vec3f(-1, 0, 0)));
+    unsigned int right  = scene->addGeometry<Plane>(new PlaneConfig(Vec3f(-4, 0, 0), Vec3f(1, 0, 0)));
+    // assign materials
+    scene->get_geometry(bottom)->assign_material(white);
+    scene->get_geometry(top)->assign_material(white);
+    scene->get_geometry(back)->assign_material(white);
+    scene->get_geometry(left)->assign_material(red);
+    scene->get_geometry(right)->assign_material(blue);
+    
+    // add spheres
+    // add material
+    unsigned int metal = scene->addMaterial<MetalMaterial>(new MetalMaterialConfig(1, 1, 1, 1, 0, 0, 0));
+    unsigned int dielectric = scene->addMaterial<DielectricMaterial>(new DielectricMaterialConfig(1, 1, 100, 3));
+    // add geometries
+    unsigned int metal_sphere = scene->addGeometry<Sphere>(new SphereConfig(Vec3f(1.8, 3.9, 1.5), 1.5));
+    unsigned int dielectric_sphere = scene->addGeometry<Sphere>(new SphereConfig(Vec3f(-1.6, 2.5, 1.5), 1.5));
+    // assign materials
+    scene->get_geometry(metal_sphere)->assign_material(metal);
+    scene->get_geometry(dielectric_sphere)->assign_material(dielectric);
+
+    // add light
+    scene->addLight<PointLight>(new PointLightConfig(0, 4.5, -2.4, 1, 1, 1));
+    scene->end_edit();
+}
+
+void triangle_scene(Scene* scene) {
+    // set up everything in one edit
+    scene->begin_edit();
+    // scene ambient light
+    scene->ambient(Vec3f(0.8, 0.8, 0.8));
+    // set up camera
+    unsigned int main_cam_id = scene->addCamera();
+    scene->activateCamera(main_cam_id);
+    scene->get_active_camera()->transform(Vec3f(0, -3, 0), Vec3f(0, 1, 0), Vec3f(0, 0, 1));
+    scene->get_active_camera()->FOV(90);
+    
+    // add materials
+    unsigned int red  = scene->addMaterial<DiffuseMaterial>(new DiffuseMaterialConfig(1, 0, 0, 1, 0, 0));
+    // add triangle
+    unsigned int T1 = scene->addGeometry<Triangle>(new TriangleConfig(Vec3f(-1, 2, 0), Vec3f(0, 2, 1), Vec3f(1, 2, 0)));
+    // apply materials to geometries
+    scene->get_geometry(T1)->assign_material(red);
+    scene->end_edit();
+}
+
+void terrain_scene(Scene* scene, unsigned int n) {
+    // set up everything in one edit
+    scene->begin_edit();
+    // scene ambient light
+    scene->ambient(Vec3f(0.6, 0.7, 0.9));
+    // set up camera looking down onto the terrain
+    unsigned int main_cam_id = scene->addCamera();
+    scene->activateCamera(main_cam_id);
+    scene->get_active_camera()->transform(Vec3f(0, -6, -2.5), Vec3f(0, 1, 0.4), Vec3f(0, 0, 1));
+    scene->get_active_camera()->FOV(90);
+
+    // add materials
+    unsigned int ground = scene->addMaterial<DiffuseMaterial>(new DiffuseMaterialConfig(0.5, 0.7, 0.4, 0.3, 0.7, 3));
+    unsigned int metal = scene->addMaterial<MetalMaterial>(new MetalMaterialConfig(0.8, 0.8, 0.8, 1, 1, 100, 0.1));
+    // height field of n x n quads - z points down like in the other scenes
+    std::vector<Vec3f> vertices;
+    std::vector<unsigned int> indices;
+    for (unsigned int j = 0; j <= n; j++) {
+        for (unsigned int i = 0; i <= n; i++) {
+            float x = 8.0f * i / n - 4, y = 8.0f * j / n - 2;
+            vertices.push_back(Vec3f(x, y, 1 - 0.3f * (sinf(2.1f * x) + cosf(1.7f * y) + 0.5f * sinf(3.3f * (x + y)))));
+        }
+    }
+    for (unsigned int j = 0; j < n; j++) {
+        for (unsigned int i = 0; i < n; i++) {
+            unsigned int k = j * (n + 1) + i;
+            indices.insert(indices.end(), { k, k + 1, k + n + 1, k + 1, k + n + 2, k + n + 1 });
+        }
+    }
+    unsigned int terrain = scene->addGeometry<TriangleMesh>(new TriangleMeshConfig(vertices, indices));
+    scene->get_geometry(terrain)->assign_material(ground);
+    // a few spheres floating above the terrain
+    for (int k = -1; k <= 1; k++) {
+        unsigned int sphere = scene->addGeometry<Sphere>(new SphereConfig(Vec3f(1.8f * k, 2, -0.5f), 0.6));
+        scene->get_geometry(sphere)->assign_material(metal);
+    }
+
+    // add light
+    scene->addLight<PointLight>(new PointLightConfig(0, 0, -4, 1, 1, 1));
+    scene->end_edit();
+}
+
+
+/*** lookup ***/
+
+bool load_scene(const char* name, Scene* scene) {
+    // find scene by name
+    if (strcmp(name, "dielectric") == 0) dielectric_scene(scene);
+    else if (strcmp(name, "cornell") == 0) cornell_scene(scene);
+    else if (strcmp(name, "triangle") == 0) triangle_scene(scene);
+    else if (strcmp(name, "terrain") == 0) terrain_scene(scene, 64);
+    else if (strcmp(name, "terrain_large") == 0) terrain_scene(scene, 256);
+    // unknown scene
+    else return false;
+    return true;
+}
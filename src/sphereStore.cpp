@@ -0,0 +1,143 @@
+#include "sphereStore.hpp"
+#include "bvh.hpp"
+#include "_defines.h"
+#include <limits>
+#include <math.h>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+/*** constructors ***/
+
+SphereStore::SphereStore(void): stride_(0) {
+    // create vector
+    this->data_ = new vector<float>();
+}
+
+
+/*** destructor ***/
+
+SphereStore::~SphereStore(void) {
+    // delete vector
+    delete this->data_;
+}
+
+
+/*** build ***/
+
+void SphereStore::build(const MemCompressor* geometries, const vector<BVHPrimitive>* prims) {
+    // pad by a full register so unaligned loads starting at any primitive stay in bounds
+    unsigned int n = prims->size();
+    this->stride_ = (n + 2 * SPHERE_STORE_WIDTH - 1) / SPHERE_STORE_WIDTH * SPHERE_STORE_WIDTH;
+    // everything but spheres never hits
+    this->data_->assign(4 * this->stride_, 0.0f);
+    float* x = this->data_->data();
+    float* y = x + this->stride_, *z = y + this->stride_, *r = z + this->stride_;
+    fill(r, r + this->stride_, numeric_limits<float>::quiet_NaN());
+    // copy center and radius in primitive order
+    const float* mem = geometries->data();
+    for (unsigned int i = 0; i < n; i++) {
+        const BVHPrimitive& prim = (*prims)[i];
+        if (prim.type_id != GEOMETRY_SPHERE_TYPE_ID) continue;
+        x[i] = mem[prim.offset + 1];
+        y[i] = mem[prim.offset + 2];
+        z[i] = mem[prim.offset + 3];
+        r[i] = mem[prim.offset + 4];
+    }
+}
+
+
+/*** cast ***/
+
+bool SphereStore::cast(unsigned int first, unsigned int count, const Vec3f origin, const Vec3f dir, float t_max, unsigned int* k, float* t) const {
+    const float* x = this->data_->data();
+    const float* y = x + this->stride_, *z = y + this->stride_, *r = z + this->stride_;
+    // same quadratic as Sphere::cast - origin relative to center is L
+    float a = Vec3f::dot(dir, dir);
+    bool hit = false;
+    *t = t_max;
+#ifdef __AVX2__
+    // broadcast ray
+    __m256 ox = _mm256_set1_ps(origin.x()), oy = _mm256_set1_ps(origin.y()), oz = _mm256_set1_ps(origin.z());
+    __m256 dx = _mm256_set1_ps(dir.x()), dy = _mm256_set1_ps(dir.y()), dz = _mm256_set1_ps(dir.z());
+    __m256 va = _mm256_set1_ps(a), zero = _mm256_setzero_ps();
+    __m256 lanes = _mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7);
+    // closest hit per lane
+    __m256 best_t = _mm256_set1_ps(t_max), best_k = _mm256_set1_ps(-1);
+    for (unsigned int j = 0; j < count; j += SPHERE_STORE_WIDTH) {
+        unsigned int i = first + j;
+        __m256 Lx = _mm256_sub_ps(ox, _mm256_loadu_ps(x + i));
+        __m256 Ly = _mm256_sub_ps(oy, _mm256_loadu_ps(y + i));
+        __m256 Lz = _mm256_sub_ps(oz, _mm256_loadu_ps(z + i));
+        __m256 vr = _mm256_loadu_ps(r + i);
+        // b = 2 * dot(dir, L) and c = dot(L, L) - r * r
+        __m256 b = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, Lx), _mm256_mul_ps(dy, Ly)), _mm256_mul_ps(dz, Lz));
+        b = _mm256_mul_ps(_mm256_set1_ps(2), b);
+        __m256 c = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(Lx, Lx), _mm256_mul_ps(Ly, Ly)), _mm256_mul_ps(Lz, Lz));
+        c = _mm256_sub_ps(c, _mm256_mul_ps(vr, vr));
+        __m256 discr = _mm256_sub_ps(_mm256_mul_ps(b, b), _mm256_mul_ps(_mm256_mul_ps(_mm256_set1_ps(4), va), c));
+        // q = -0.5 * (b + sign(b) * sqrt(discr)) - also covers the tangent case
+        __m256 root = _mm256_sqrt_ps(discr);
+        __m256 q = _mm256_blendv_ps(_mm256_sub_ps(b, root), _mm256_add_ps(b, root), _mm256_cmp_ps(b, zero, _CMP_GT_OQ));
+        q = _mm256_mul_ps(_mm256_set1_ps(-0.5f), q);
+        __m256 tj = _mm256_min_ps(_mm256_div_ps(c, q), _mm256_div_ps(q, va));
+        // lanes past the range, missed spheres and other primitives fail the comparisons
+        __m256 lane = _mm256_add_ps(lanes, _mm256_set1_ps((float)j));
+        __m256 mask = _mm256_cmp_ps(lane, _mm256_set1_ps((float)count), _CMP_LT_OQ);
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(discr, zero, _CMP_GE_OQ));
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(tj, zero, _CMP_GT_OQ));
+        mask = _mm256_and_ps(mask, _mm256_cmp_ps(tj, best_t, _CMP_LT_OQ));
+        best_t = _mm256_blendv_ps(best_t, tj, mask);
+        best_k = _mm256_blendv_ps(best_k, lane, mask);
+    }
+    // reduce lanes
+    float lane_t[SPHERE_STORE_WIDTH], lane_k[SPHERE_STORE_WIDTH];
+    _mm256_storeu_ps(lane_t, best_t);
+    _mm256_storeu_ps(lane_k, best_k);
+    for (unsigned int l = 0; l < SPHERE_STORE_WIDTH; l++) {
+        if ((lane_k[l] >= 0) && (lane_t[l] < *t)) { hit = true; *t = lane_t[l]; *k = first + (unsigned int)lane_k[l]; }
+    }
+#else
+    // scalar fallback with the same arithmetic
+    for (unsigned int i = first; i < first + count; i++) {
+        float Lx = origin.x() - x[i], Ly = origin.y() - y[i], Lz = origin.z() - z[i];
+        float b = 2 * (dir.x() * Lx + dir.y() * Ly + dir.z() * Lz);
+        float c = (Lx * Lx + Ly * Ly + Lz * Lz) - r[i] * r[i];
+        float discr = b * b - 4 * a * c;
+        if (!(discr >= 0)) continue;
+        float root = sqrtf(discr);
+        float q = -0.5f * ((b > 0)? (b + root) : (b - root));
+        float ti = min(q / a, c / q);
+        if ((ti > 0) && (ti < *t)) { hit = true; *t = ti; *k = i; }
+    }
+#endif
+    // return hit
+    return hit;
+}
+
+Float8 SphereStore::cast_packet(unsigned int first, unsigned int count, const Vec3f8& origin, const Vec3f8& dir, Float8 active, Float8* t, unsigned int* k) const {
+    const float* x = this->data_->data();
+    const float* y = x + this->stride_, *z = y + this->stride_, *r = z + this->stride_;
+    // rays in the lanes and one sphere at a time - each lane computes exactly what cast computes for its ray
+    Float8 a = Vec3f8::dot(dir, dir);
+    Float8 hit(0.0f);
+    for (unsigned int i = first; i < first + count; i++) {
+        Float8 Lx = origin.x - Float8(x[i]), Ly = origin.y - Float8(y[i]), Lz = origin.z - Float8(z[i]);
+        Float8 b = Float8(2) * (dir.x * Lx + dir.y * Ly + dir.z * Lz);
+        Float8 c = (Lx * Lx + Ly * Ly + Lz * Lz) - Float8(r[i] * r[i]);
+        Float8 discr = b * b - Float8(4) * a * c;
+        Float8 root = Float8::sqrt(discr);
+        Float8 q = Float8(-0.5f) * Float8::select(b > Float8(0), b + root, b - root);
+        Float8 ti = Float8::min(q / a, c / q);
+        // missed spheres and other primitives fail the comparisons
+        Float8 closer = active & (discr >= Float8(0)) & (ti > Float8(0)) & (ti < *t);
+        int bits = closer.bits();
+        if (bits == 0) continue;
+        *t = Float8::select(closer, ti, *t);
+        hit = hit | closer;
+        for (unsigned int l = 0; l < PACKET_SIZE; l++) { if (bits & (1 << l)) k[l] = i; }
+    }
+    return hit;
+}
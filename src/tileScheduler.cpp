@@ -0,0 +1,105 @@
+#include "tileScheduler.hpp"
+#include <algorithm>
+
+using namespace std;
+
+/*** constructors ***/
+
+TileScheduler::TileScheduler(unsigned int n_threads): generation(0), n_done(0), stop(false) {
+    // at least one worker
+    n_threads = max(n_threads, 1u);
+    // create one queue per worker
+    this->queues = new vector<TileQueue*>();
+    for (unsigned int i = 0; i < n_threads; i++) { this->queues->push_back(new TileQueue()); }
+    // start workers
+    this->workers = new vector<thread>();
+    for (unsigned int i = 0; i < n_threads; i++) { this->workers->emplace_back(&TileScheduler::work, this, i); }
+}
+
+
+/*** destructor ***/
+
+TileScheduler::~TileScheduler(void) {
+    // stop all workers
+    {
+        lock_guard<mutex> lock(this->state_lock);
+        this->stop = true;
+    }
+    this->job_cv.notify_all();
+    for (thread& t : *this->workers) { t.join(); }
+    // delete queues and vectors
+    for (TileQueue* q : *this->queues) { delete q; }
+    delete this->queues;
+    delete this->workers;
+}
+
+
+/*** private methods ***/
+
+void TileScheduler::work(unsigned int worker_id) {
+    unsigned int seen_generation = 0;
+    while (true) {
+        // wait for next job
+        {
+            unique_lock<mutex> lock(this->state_lock);
+            this->job_cv.wait(lock, [&]{ return this->stop || (this->generation != seen_generation); });
+            if (this->stop) return;
+            seen_generation = this->generation;
+        }
+        // process tiles until none are left
+        Tile tile;
+        while (this->next_tile(worker_id, &tile)) { this->job(tile); }
+        // report finished worker
+        {
+            lock_guard<mutex> lock(this->state_lock);
+            this->n_done++;
+        }
+        this->done_cv.notify_one();
+    }
+}
+
+bool TileScheduler::next_tile(unsigned int worker_id, Tile* tile) {
+    unsigned int n = this->queues->size();
+    // take from front of own queue first, then steal from back of others
+    for (unsigned int k = 0; k < n; k++) {
+        TileQueue* q = this->queues->at((worker_id + k) % n);
+        lock_guard<mutex> lock(q->lock);
+        if (q->tiles.empty()) continue;
+        // own queue
+        if (k == 0) { *tile = q->tiles.front(); q->tiles.pop_front(); }
+        // steal
+        else { *tile = q->tiles.back(); q->tiles.pop_back(); }
+        return true;
+    }
+    // all queues are empty
+    return false;
+}
+
+
+/*** public methods ***/
+
+void TileScheduler::run(unsigned int w, unsigned int y0, unsigned int y1, function<void(const Tile&)> job) {
+    // count tiles in both directions - rows are tiled from the first row of the range
+    unsigned int n_x = (w + TILE_SIZE - 1) / TILE_SIZE;
+    unsigned int n_y = (y1 - y0 + TILE_SIZE - 1) / TILE_SIZE;
+    unsigned int n_tiles = n_x * n_y;
+    unsigned int n = this->queues->size();
+    if (n_tiles == 0) return;
+    // hand out contiguous runs of tiles to keep neighbouring tiles on the same worker
+    for (unsigned int i = 0; i < n_tiles; i++) {
+        unsigned int tx = i % n_x, ty = i / n_x;
+        Tile tile = { tx * TILE_SIZE, y0 + ty * TILE_SIZE, min((tx + 1) * TILE_SIZE, w), min(y0 + (ty + 1) * TILE_SIZE, y1) };
+        this->queues->at((unsigned long)i * n / n_tiles)->tiles.push_back(tile);
+    }
+    // start job
+    {
+        lock_guard<mutex> lock(this->state_lock);
+        this->job = job;
+        this->n_done = 0;
+        this->generation++;
+    }
+    this->job_cv.notify_all();
+    // wait for all workers to finish
+    unique_lock<mutex> lock(this->state_lock);
+    this->done_cv.wait(lock, [&]{ return this->n_done == n; });
+}
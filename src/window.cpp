@@ -51,3 +51,11 @@ void Window::display(void) {
     // display renderer
     SDL_RenderPresent(this->renderer);
 }
+
+void Window::display(const void* pixels) {
+    // copy pixels to texture and show it
+    SDL_UpdateTexture(this->texture, NULL, pixels, 4 * this->width);
+    SDL_RenderCopy(this->renderer, this->texture, NULL, NULL);
+    // display renderer
+    SDL_RenderPresent(this->renderer);
+}
@@ -0,0 +1,73 @@
+// external
+#include "CL/cl2.hpp"
+// internal
+#include "workGroupTuner.hpp"
+#include "programCache.hpp"
+// standard
+#include <vector>
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <stdint.h>
+
+using namespace std;
+
+/* candidate shapes - from single rows to square tiles */
+static const WorkGroup WORK_GROUP_SHAPES[] = {
+    { 1, 32 }, { 1, 64 }, { 1, 128 }, { 2, 32 }, { 2, 64 }, { 4, 8 }, { 4, 16 }, { 4, 32 },
+    { 8, 8 }, { 8, 16 }, { 8, 32 }, { 16, 8 }, { 16, 16 }
+};
+/* timed launches of each shape after one warm-up launch */
+#define WORK_GROUP_RUNS 3
+
+/*** cache ***/
+
+static bool load_shape(const string& path, const string& key, WorkGroup* shape) {
+    // shape is the only data after the key
+    string data;
+    uint32_t dims[2] = { 0, 0 };
+    if (!read_cache_file(path, key, &data) || (data.size() != sizeof(dims))) return false;
+    memcpy(dims, data.data(), sizeof(dims));
+    if ((dims[0] == 0) || (dims[1] == 0)) return false;
+    *shape = { dims[0], dims[1] };
+    return true;
+}
+
+static void store_shape(const string& path, const string& key, const WorkGroup& shape) {
+    uint32_t dims[2] = { shape.rows, shape.cols };
+    write_cache_file(path, key, (const char*)dims, sizeof(dims));
+}
+
+
+/*** tuner ***/
+
+WorkGroup tune_work_group(const cl::Device& device, const cl::Kernel& kernel, const string& key, function<void(const WorkGroup&)> launch) {
+    // shapes are specific to device, driver and kernel build
+    string full_key = device.getInfo<CL_DEVICE_NAME>() + "\n" + device.getInfo<CL_DRIVER_VERSION>() + "\n"
+        + kernel.getInfo<CL_KERNEL_FUNCTION_NAME>() + "\n" + key;
+    string path = cache_path(full_key, ".wg");
+    WorkGroup best = { 0, 0 };
+    if (load_shape(path, full_key, &best)) return best;
+    // limits of kernel and device
+    size_t max_size = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+    vector<size_t> max_items = device.getInfo<CL_DEVICE_MAX_WORK_ITEM_SIZES>();
+    // measure every shape the device can run
+    double best_time = 0;
+    for (const WorkGroup& shape : WORK_GROUP_SHAPES) {
+        if ((shape.rows * shape.cols > max_size) || (max_items.size() < 2) || (shape.rows > max_items[0]) || (shape.cols > max_items[1])) continue;
+        launch(shape);
+        double time = 0;
+        for (unsigned int r = 0; r < WORK_GROUP_RUNS; r++) {
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            launch(shape);
+            double t = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            time = (r == 0)? t : min(time, t);
+        }
+        if ((best.rows == 0) || (time < best_time)) { best = shape; best_time = time; }
+    }
+    // a single work-item always fits
+    if (best.rows == 0) best = { 1, 1 };
+    cout << "Tuned work-group " << best.rows << "x" << best.cols << " for " << kernel.getInfo<CL_KERNEL_FUNCTION_NAME>() << endl;
+    store_shape(path, full_key, best);
+    return best;
+}